@@ -0,0 +1,54 @@
+#include "CutsceneCommandHandler.h"
+
+TMap<const UScriptStruct*, TSharedRef<ICutsceneCommandHandler>> FCutsceneCommandHandlers::Handlers;
+
+void FCutsceneCommandHandlers::Register(const UScriptStruct& CommandStruct, TSharedRef<ICutsceneCommandHandler> Handler)
+{
+	check(IsInGameThread());
+	Handlers.Add(&CommandStruct, MoveTemp(Handler));
+}
+
+void FCutsceneCommandHandlers::Unregister(const UScriptStruct& CommandStruct)
+{
+	check(IsInGameThread());
+	Handlers.Remove(&CommandStruct);
+}
+
+ICutsceneCommandHandler* FCutsceneCommandHandlers::Find(const UScriptStruct* CommandStruct)
+{
+	const auto HandlerPtr = Handlers.Find(CommandStruct);
+	return HandlerPtr ? &HandlerPtr->Get() : nullptr;
+}
+
+void FCutsceneCommandHandlers::RegisterBuiltInHandlers()
+{
+	Register<FToastieCutsceneWait>(MakeShared<FCutsceneWaitHandler>());
+	Register<FToastieCutsceneEnablePlayerControl>(MakeShared<FCutsceneEnablePlayerControlHandler>());
+	Register<FToastieCutsceneDisablePlayerControl>(MakeShared<FCutsceneDisablePlayerControlHandler>());
+}
+
+void FCutsceneCommandHandlers::UnregisterAll()
+{
+	Handlers.Empty();
+}
+
+ECutscenePlayerExecuteResult FCutsceneWaitHandler::Execute(ACutscenePlayer& CutscenePlayer, const int32 Id, const FToastieCutsceneWait& Command)
+{
+	if (Command.Time <= 0.0)
+		return ECutscenePlayerExecuteResult::Finished;
+
+	CutscenePlayer.FinishCommandAfter(Id, static_cast<float>(Command.Time));
+	return ECutscenePlayerExecuteResult::InProgress;
+}
+
+ECutscenePlayerExecuteResult FCutsceneEnablePlayerControlHandler::Execute(ACutscenePlayer& CutscenePlayer, const int32 Id, const FToastieCutsceneEnablePlayerControl& Command)
+{
+	CutscenePlayer.EnablePlayerControl();
+	return ECutscenePlayerExecuteResult::Finished;
+}
+
+ECutscenePlayerExecuteResult FCutsceneDisablePlayerControlHandler::Execute(ACutscenePlayer& CutscenePlayer, const int32 Id, const FToastieCutsceneDisablePlayerControl& Command)
+{
+	CutscenePlayer.DisablePlayerControl();
+	return ECutscenePlayerExecuteResult::Finished;
+}
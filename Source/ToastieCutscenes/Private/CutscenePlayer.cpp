@@ -1,12 +1,55 @@
 #include "CutscenePlayer.h"
+#include "CutsceneCommandHandler.h"
+#include "TimerManager.h"
+#include "GameFramework/PlayerController.h"
+#include "ToastieCutsceneSubsystem.h"
+#include "ToastieCutscenesStats.h"
+
+namespace
+{
+	// Names ExecuteCommand events in Unreal Insights by the type of command
+	const TCHAR* GetExecuteEventName(const EToastieCutsceneOpcode Opcode)
+	{
+		switch (Opcode)
+		{
+		case EToastieCutsceneOpcode::Custom: return TEXT("ToastieCutscenes_Execute_Custom");
+		case EToastieCutsceneOpcode::PlayerChoice: return TEXT("ToastieCutscenes_Execute_PlayerChoice");
+		case EToastieCutsceneOpcode::Say: return TEXT("ToastieCutscenes_Execute_Say");
+		case EToastieCutsceneOpcode::EnablePlayerControl: return TEXT("ToastieCutscenes_Execute_EnablePlayerControl");
+		case EToastieCutsceneOpcode::DisablePlayerControl: return TEXT("ToastieCutscenes_Execute_DisablePlayerControl");
+		case EToastieCutsceneOpcode::Wait: return TEXT("ToastieCutscenes_Execute_Wait");
+		case EToastieCutsceneOpcode::LookAt: return TEXT("ToastieCutscenes_Execute_LookAt");
+		case EToastieCutsceneOpcode::Exit: return TEXT("ToastieCutscenes_Execute_Exit");
+		case EToastieCutsceneOpcode::Goto: return TEXT("ToastieCutscenes_Execute_Goto");
+		default: return TEXT("ToastieCutscenes_Execute");
+		}
+	}
+
+	// Commands that steer the player's processes, they never go to a handler or to Blueprint
+	bool IsFlowOpcode(const EToastieCutsceneOpcode Opcode)
+	{
+		return Opcode == EToastieCutsceneOpcode::Exit
+			|| Opcode == EToastieCutsceneOpcode::PlayerChoice
+			|| Opcode == EToastieCutsceneOpcode::Goto;
+	}
+}
 
 // Sets default values
 ACutscenePlayer::ACutscenePlayer()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	// Scenes are ticked by UToastieCutsceneSubsystem, the actor tick is left to subclasses that want it
 	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
 	Scene = nullptr;
-	IdCounter = 0;
+	bUseBlueprintRequirements = false;
+	bPrefetchBranches = false;
+	bDestroyOnFinish = true;
+	bLoadedSoftScene = false;
+	bWaitingForSoftScene = false;
+	bPlaying = false;
+	RunHandle = INDEX_NONE;
+	PlaySerial = 0;
+	bWarnedMissingValueProvider = false;
 }
 
 // Called when the game starts or when spawned
@@ -14,226 +57,327 @@ void ACutscenePlayer::BeginPlay()
 {
 	Super::BeginPlay();
 
-	if (Scene)
+	// Only subclasses that use Event Tick pay for the actor tick
+	if (GetClass()->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(ACutscenePlayer, ReceiveTick)))
 	{
-		Process.EndIndex = Scene->Commands.Num() - 1;
-		Process.FetchCommands(*this);
+		SetActorTickEnabled(true);
 	}
-	else
+
+	if (!Scene && !SoftScene.IsNull())
 	{
-		// No scene was set, delete this actor
-		Destroy();
+		if (auto Subsystem = GetCutsceneSubsystem())
+		{
+			// Nothing runs until the Scene has streamed in
+			bLoadedSoftScene = true;
+			bWaitingForSoftScene = true;
+			Subsystem->LoadScene(SoftScene, [WeakThis = TWeakObjectPtr<ACutscenePlayer>(this)](UToastieCutsceneAsset* LoadedScene)
+			{
+				if (auto This = WeakThis.Get())
+				{
+					This->OnSceneLoaded(LoadedScene);
+				}
+			});
+			return;
+		}
 	}
+
+	StartScene();
 }
 
-void ACutscenePlayer::FinishCommand(const int32 Id)
+void ACutscenePlayer::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	// Each Id should only be used once
-	// For safety's sake, run through each active process anyways
-	// and finish any command with a matching Id
-	ForEachProcess([Id](FAProcess& CurrentProcess)
-	{
-		for (auto& Command : CurrentProcess.ActiveCommands)
-		{
-			if (Command.Id == Id)
-				Command.State = FAProcess::ECommandStates::Finished;
-		}
-	});
+	// The subsystem would only drop the run of a destroyed player on its next tick
+	Stop();
+	ReleaseSoftScene();
+	Super::EndPlay(EndPlayReason);
 }
 
-void ACutscenePlayer::FinishPlayerChoice(const int32 Id, const FToastieCutsceneOption& Option)
+void ACutscenePlayer::Play(UToastieCutsceneAsset* InScene)
 {
-	if (Option.Label.Equals(TEXT("Exit")))
+	Stop();
+
+	Scene = InScene;
+	auto Subsystem = GetCutsceneSubsystem();
+	if (Scene && Subsystem)
 	{
-		ForEachProcess([Id](FAProcess& CurrentProcess)
-		{
-			for (auto& Command : CurrentProcess.ActiveCommands)
-			{
-				if (Command.Id == Id)
-					Command.State = FAProcess::ECommandStates::Finished;
-			}
-			CurrentProcess.CurrentIndex = INT32_MAX;
-		});
+		bPlaying = true;
+		RunHandle = Subsystem->StartRun(*this, *Scene);
 	}
-	else
+}
+
+void ACutscenePlayer::Stop()
+{
+	// Safe to call from a command handler, the subsystem stops ticking the old Scene once it's released
+	if (RunHandle != INDEX_NONE)
 	{
-		if (auto LabelIndex = FindLabel(Option.Label);
-			Scene && Scene->Commands.IsValidIndex(LabelIndex))
+		if (auto Subsystem = GetCutsceneSubsystem())
 		{
-			ForEachProcess([Id, LabelIndex](FAProcess& CurrentProcess)
-			{
-				for (auto& Command : CurrentProcess.ActiveCommands)
-				{
-					if (Command.Id == Id)
-					{
-						Command.State = FAProcess::ECommandStates::Finished;
-						CurrentProcess.CurrentIndex = LabelIndex + 1;
-					}
-				}
-			});
+			Subsystem->StopRun(RunHandle);
 		}
+		RunHandle = INDEX_NONE;
 	}
+	bPlaying = false;
+	bWaitingForSoftScene = false;
+	++PlaySerial;
+	PresentedChoices.Reset();
+
+	// A Scene that's stopped or finished doesn't keep the player's input
+	EnablePlayerControl();
 }
 
-// Called every frame
-void ACutscenePlayer::Tick(const float DeltaTime)
+void ACutscenePlayer::ResetForPool()
 {
-	Super::Tick(DeltaTime);
+	Stop();
+	ReleaseSoftScene();
+	Scene = nullptr;
+	SoftScene.Reset();
+}
 
-	Process.Tick(DeltaTime, *this);
-	
-	if (Process.IsFinished(*this))
+void ACutscenePlayer::StartScene()
+{
+	if (Scene)
 	{
+		Play(Scene);
+	}
+	else if (bDestroyOnFinish)
+	{
+		// No scene was set, delete this actor
 		Destroy();
 	}
 }
 
-void ACutscenePlayer::FAProcess::Tick(const float DeltaTime, ACutscenePlayer& CutscenePlayer)
+void ACutscenePlayer::OnSceneLoaded(UToastieCutsceneAsset* LoadedScene)
 {
-	if (Delay > 0.0f)
-	{
-		Delay -= DeltaTime;
+	if (!bWaitingForSoftScene || IsActorBeingDestroyed())
 		return;
-	}
 
-	// Tick children
-	bool bAtLeastOneBlockingChild = false;
-	for (auto& Child : Children)
+	bWaitingForSoftScene = false;
+	Scene = LoadedScene;
+	StartScene();
+}
+
+void ACutscenePlayer::FinishScene()
+{
+	Stop();
+	OnCutsceneFinished.Broadcast(this);
+
+	// A listener may have started another Scene
+	if (bDestroyOnFinish && !bPlaying)
 	{
-		Child.Tick(DeltaTime, CutscenePlayer);
-		bAtLeastOneBlockingChild |= Child.bBlocking;
+		Destroy();
 	}
+}
 
-	// Clear finished children
-	struct FRemoveFinishedChildren
+void ACutscenePlayer::ReleaseSoftScene()
+{
+	if (bLoadedSoftScene)
 	{
-		const ACutscenePlayer& CutscenePlayer;
-		bool operator()(const FAProcess& Process) const
+		if (auto Subsystem = GetCutsceneSubsystem())
 		{
-			return Process.IsFinished(CutscenePlayer);
+			Subsystem->ReleaseScene(SoftScene);
 		}
-	};
-	Children.RemoveAll(FRemoveFinishedChildren { CutscenePlayer });
+		bLoadedSoftScene = false;
+	}
+}
 
-	if (!Children.IsEmpty() && bAtLeastOneBlockingChild)
+UToastieCutsceneSubsystem* ACutscenePlayer::GetCutsceneSubsystem() const
+{
+	const auto World = GetWorld();
+	return World ? World->GetSubsystem<UToastieCutsceneSubsystem>() : nullptr;
+}
+
+FCutsceneProcessPool* ACutscenePlayer::GetProcessPool() const
+{
+	const auto Subsystem = RunHandle != INDEX_NONE ? GetCutsceneSubsystem() : nullptr;
+	return Subsystem ? Subsystem->GetRunProcessPool(RunHandle) : nullptr;
+}
+
+void ACutscenePlayer::FinishCommand(const int32 Id)
+{
+	if (auto Pool = GetProcessPool())
 	{
-		return;
+		Pool->FinishCommand(Id);
+		GetCutsceneSubsystem()->WakeRun(RunHandle);
 	}
+}
 
-	// Tick active commands
-	for (auto& [Id, Index, DelayedTimeRemaining, State, bCommandIsBlocking] : ActiveCommands)
+void ACutscenePlayer::FinishCommandAfter(const int32 Id, const float Time)
+{
+	FTimerHandle TimerHandle;
+	GetWorldTimerManager().SetTimer(TimerHandle, FTimerDelegate::CreateWeakLambda(this, [this, Id, Serial = PlaySerial]()
 	{
-		if (State == ECommandStates::Delayed)
+		if (PlaySerial == Serial)
 		{
-			DelayedTimeRemaining -= DeltaTime;
-			if (DelayedTimeRemaining <= 0.0f)
-			{
-				State = ECommandStates::Queued;
-			}
+			FinishCommand(Id);
 		}
+	}), Time, false);
+}
 
-		if (State == ECommandStates::Queued)
-		{
-			const auto Result = CutscenePlayer.ExecuteCommand(Index, Id);
-			State = Result == ECutscenePlayerExecuteResult::Finished ?
-				ECommandStates::Finished : ECommandStates::Running;
-		}
-	}
+void ACutscenePlayer::DisablePlayerControl()
+{
+	if (DisabledPlayerController.IsValid())
+		return;
 
-	// Clear finished commands
-	struct FRemoveFinishedCommands
+	const auto World = GetWorld();
+	if (const auto PlayerController = World ? World->GetFirstPlayerController() : nullptr; PlayerController)
 	{
-		bool operator()(const FCommandState& Command) const
-		{
-			return Command.State == ECommandStates::Finished;
-		}
-	};
-	ActiveCommands.RemoveAll(FRemoveFinishedCommands());
+		PlayerController->SetIgnoreMoveInput(true);
+		PlayerController->SetIgnoreLookInput(true);
+		DisabledPlayerController = PlayerController;
+	}
+}
 
-	// If all current commands have finished,
-	// fetch new commands
-	if (IsFinishedCurrentActions())
+void ACutscenePlayer::EnablePlayerControl()
+{
+	// Ignored input is counted, so undoing only our own Disable leaves locks held by anything else in place
+	if (const auto PlayerController = DisabledPlayerController.Get(); PlayerController)
 	{
-		FetchCommands(CutscenePlayer);
+		PlayerController->SetIgnoreMoveInput(false);
+		PlayerController->SetIgnoreLookInput(false);
 	}
+	DisabledPlayerController.Reset();
 }
 
-bool ACutscenePlayer::FAProcess::IsFinishedCurrentActions() const
+void ACutscenePlayer::FinishPlayerChoice(const int32 Id, const int32 OptionIndex)
 {
-	for (const auto& ActiveCommand : ActiveCommands)
+	const auto PresentedIndex = PresentedChoices.IndexOfByPredicate([Id](const FPresentedChoice& Presented) { return Presented.Id == Id; });
+	if (!Scene || PresentedIndex == INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("TCS: PlayerChoice %d isn't waiting on an Option in %s"), Id, *GetNameSafe(Scene));
+		return;
+	}
+
+	const auto Choice = PresentedChoices[PresentedIndex].Choice;
+	if (!Choice.IsOptionVisible(OptionIndex))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("TCS: Option %d of PlayerChoice %d wasn't shown in %s"), OptionIndex, Id, *GetNameSafe(Scene));
+		return;
+	}
+	PresentedChoices.RemoveAtSwap(PresentedIndex, 1, EAllowShrinking::No);
+
+	const auto Target = Scene->GetFlow(Scene->GetChoiceOptions(Choice.CommandIndex)[OptionIndex]).Target;
+	if (Target == FToastieCutsceneFlowNode::ExitTarget)
 	{
-		if (ActiveCommand.bBlocking &&
-			ActiveCommand.State != ECommandStates::Finished)
+		if (auto Pool = GetProcessPool())
 		{
-			return false;
+			Pool->StopFetching();
 		}
 	}
-	return true;
+	else if (!JumpToTarget(Id, Target))
+	{
+		// The missing Label was reported on import, carry on after the PlayerChoice rather than stall the Scene
+		UE_LOG(LogTemp, Warning, TEXT("TCS: Option %d of PlayerChoice %d leads nowhere in %s"), OptionIndex, Id, *GetNameSafe(Scene));
+	}
+	FinishCommand(Id);
+}
+
+FText ACutscenePlayer::GetChoiceOptionText(const FToastieCutsceneChoice& Choice, const int32 OptionIndex) const
+{
+	const auto Option = GetChoiceOption(Choice, OptionIndex);
+	return Option ? Option->DisplayText : FText::GetEmpty();
 }
 
-bool ACutscenePlayer::FAProcess::IsFinished(const ACutscenePlayer& CutscenePlayer) const
+FName ACutscenePlayer::GetChoiceOptionLabel(const FToastieCutsceneChoice& Choice, const int32 OptionIndex) const
 {
-	return !CutscenePlayer.Scene || (ActiveCommands.IsEmpty() && Children.IsEmpty());
+	const auto Option = GetChoiceOption(Choice, OptionIndex);
+	return Option ? Option->Label : NAME_None;
 }
 
-void ACutscenePlayer::FAProcess::FetchCommands(ACutscenePlayer& CutscenePlayer)
+const FToastieCutsceneOption* ACutscenePlayer::GetChoiceOption(const FToastieCutsceneChoice& Choice, const int32 OptionIndex) const
 {
-	while (CutscenePlayer.Scene
-		&& CutscenePlayer.Scene->Commands.IsValidIndex(CurrentIndex)
-		&& CurrentIndex <= EndIndex)
+	if (!Scene || !Scene->Commands.IsValidIndex(Choice.CommandIndex) || Scene->GetOpcode(Choice.CommandIndex) != EToastieCutsceneOpcode::PlayerChoice)
+		return nullptr;
+
+	const auto Options = Scene->GetChoiceOptions(Choice.CommandIndex);
+	return Options.IsValidIndex(OptionIndex) ? &Scene->GetCommand<FToastieCutsceneOption>(Options[OptionIndex]) : nullptr;
+}
+
+bool ACutscenePlayer::JumpToTarget(const int32 Id, const int32 Target)
+{
+	// Continue the process that ran the command from Target
+	auto Pool = GetProcessPool();
+	return Pool && Target >= 0 && Pool->ContinueFrom(Id, Target);
+}
+
+bool ACutscenePlayer::UsesBlueprintRequirements() const
+{
+	// Players set up before ValueProvider existed keep checking Requirements in Blueprint
+	return bUseBlueprintRequirements
+		|| (!ValueProvider.GetInterface() && GetClass()->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(ACutscenePlayer, RequirementsAreMet)));
+}
+
+bool ACutscenePlayer::ImplementsExecuteEvent(const EToastieCutsceneOpcode Opcode) const
+{
+	FName EventName;
+	switch (Opcode)
 	{
-		if (const auto CommandPtr = CutscenePlayer.Scene->Commands[CurrentIndex].GetPtr<FToastieCutsceneCommandBase>();
-			CommandPtr)
-		{
+	case EToastieCutsceneOpcode::Say:					EventName = GET_FUNCTION_NAME_CHECKED(ACutscenePlayer, ExecuteSay); break;
+	case EToastieCutsceneOpcode::EnablePlayerControl:	EventName = GET_FUNCTION_NAME_CHECKED(ACutscenePlayer, ExecuteEnablePlayerControl); break;
+	case EToastieCutsceneOpcode::DisablePlayerControl:	EventName = GET_FUNCTION_NAME_CHECKED(ACutscenePlayer, ExecuteDisablePlayerControl); break;
+	case EToastieCutsceneOpcode::Wait:					EventName = GET_FUNCTION_NAME_CHECKED(ACutscenePlayer, ExecuteWait); break;
+	case EToastieCutsceneOpcode::LookAt:				EventName = GET_FUNCTION_NAME_CHECKED(ACutscenePlayer, ExecuteLookAt); break;
+	default:											return false;
+	}
+	return GetClass()->IsFunctionImplementedInScript(EventName);
+}
 
-			const auto bRequirementsMet = CutscenePlayer.RequirementsAreMet(CommandPtr->Requirements);
-			const auto BlockPtr = CutscenePlayer.Scene->Commands[CurrentIndex].GetPtr<FToastieCutsceneBlock>();
-			
-			if (BlockPtr && BlockPtr->Type != EToastieCutsceneBlockType::PlayerChoice)
-			{
-				if (bRequirementsMet)
-				{
-					FAProcess ChildProcess;
-					ChildProcess.CurrentIndex = CurrentIndex + 1;
-					ChildProcess.EndIndex = CurrentIndex + BlockPtr->CommandCount;
-					ChildProcess.bConcurrent = BlockPtr->Type == EToastieCutsceneBlockType::Concurrent;
-					ChildProcess.Delay = BlockPtr->Delay;
-					ChildProcess.bBlocking = !BlockPtr->bDoNotBlock;
-					ChildProcess.FetchCommands(CutscenePlayer);
-					Children.Add(ChildProcess);
-				}
-				
-				CurrentIndex += 1 + BlockPtr->CommandCount;
-			}
-			else
-			{
-				if (bRequirementsMet)
-				{
-					// Add this command to the active command list
-					FCommandState State;
-					State.Id = ++CutscenePlayer.IdCounter;
-					State.Index = CurrentIndex;
-					State.DelayedTimeRemaining = CommandPtr->Delay;
-					State.State = CommandPtr->Delay > 0.0f ? ECommandStates::Delayed : ECommandStates::Queued;
-					State.bBlocking = !CommandPtr->bDoNotBlock;
-
-					ActiveCommands.Add(State);
-				}
+void ACutscenePlayer::WarnMissingValueProvider()
+{
+	if (bWarnedMissingValueProvider || ValueProvider.GetInterface() || bUseBlueprintRequirements)
+		return;
 
-				CurrentIndex += 1 + (BlockPtr ? BlockPtr->CommandCount : 0);
-			}
-			
-			if (bConcurrent || CommandPtr->bDoNotBlock)
-				continue;
+	bWarnedMissingValueProvider = true;
+	if (UsesBlueprintRequirements())
+	{
+		UE_LOG(LogTemp, Log, TEXT("TCS: %s has no ValueProvider, Requirements are checked with RequirementsAreMet"), *GetName());
+	}
+	else
+	{
+		UE_LOG(LogTemp, Warning, TEXT("TCS: %s has no ValueProvider or RequirementsAreMet, every Requirement reads its value as 0"), *GetName());
+	}
+}
 
-			// All possible commands have been added to the queue
-			// Let them tick and finish before fetching more commands
-			return;
+void ACutscenePlayer::EvaluateRequirements(TConstArrayView<const TArray<FToastieCutsceneReq>*> RequirementLists, TArrayView<bool> OutMet)
+{
+	TOASTIECUTSCENES_SCOPE(Requirements);
+	WarnMissingValueProvider();
+	if (UsesBlueprintRequirements())
+	{
+		for (int32 i = 0; i < RequirementLists.Num(); ++i)
+		{
+			OutMet[i] = RequirementLists[i]->IsEmpty() || RequirementsAreMet(*RequirementLists[i]);
 		}
-		
-		// Invalid command, ignored
-		++CurrentIndex;
 	}
+	else
+	{
+		IToastieCutsceneValueProvider::AreRequirementsMet(ValueProvider.GetInterface(), RequirementLists, OutMet);
+	}
+}
+
+bool ACutscenePlayer::CheckRequirements(const TArray<FToastieCutsceneReq>& Reqs)
+{
+	if (Reqs.IsEmpty())
+		return true;
+
+	TOASTIECUTSCENES_SCOPE(Requirements);
+	WarnMissingValueProvider();
+	return UsesBlueprintRequirements()
+		? RequirementsAreMet(Reqs)
+		: IToastieCutsceneValueProvider::AreRequirementsMet(ValueProvider.GetInterface(), Reqs);
+}
+
+bool ACutscenePlayer::CanCheckRequirementsOnAnyThread() const
+{
+	if (UsesBlueprintRequirements())
+		return false;
+
+	const auto Provider = ValueProvider.GetInterface();
+	return !Provider || Provider->CanReadValuesOnAnyThread();
+}
+
+bool ACutscenePlayer::StartCommand(const int32 Index, const int32 Id)
+{
+	return ExecuteCommand(Index, Id) == ECutscenePlayerExecuteResult::Finished;
 }
 
 ECutscenePlayerExecuteResult ACutscenePlayer::ExecuteCommand(const int32 Index, const int32 Id)
@@ -241,66 +385,90 @@ ECutscenePlayerExecuteResult ACutscenePlayer::ExecuteCommand(const int32 Index,
 	if (!Scene || !Scene->Commands.IsValidIndex(Index))
 		return ECutscenePlayerExecuteResult::Finished;
 
-	const auto& Data = Scene->Commands[Index];
-	auto Result = ECutscenePlayerExecuteResult::Finished;
+	const auto Opcode = Scene->GetOpcode(Index);
+	SCOPE_CYCLE_COUNTER(STAT_ToastieCutscenes_ExecuteCommand);
+	TRACE_CPUPROFILER_EVENT_SCOPE_TEXT(GetExecuteEventName(Opcode));
 
-	if (const auto ExitData = Data.GetPtr<FToastieCutsceneExit>();
-		ExitData)
+	// Native handlers come first, the Blueprint events below are the fallback
+	if (!IsFlowOpcode(Opcode) && !ImplementsExecuteEvent(Opcode))
 	{
-		ForEachProcess([](FAProcess& CurrentProcess)
-		{
-			CurrentProcess.CurrentIndex = INT32_MAX;
-		});
-		return Result;
+		const auto& Command = Scene->Commands[Index];
+		if (const auto Handler = FCutsceneCommandHandlers::Find(Command.GetScriptStruct()))
+			return Handler->Execute(*this, Id, Command);
 	}
 
-	if (const auto PlayerChoiceData = Data.GetPtr<FToastieCutsceneBlock>();
-		PlayerChoiceData && PlayerChoiceData->Type == EToastieCutsceneBlockType::PlayerChoice)
+	switch (Opcode)
 	{
-		TArray<FToastieCutsceneOption> Options;
-		for (int i = 1; i <= PlayerChoiceData->CommandCount; ++i)
+	case EToastieCutsceneOpcode::Exit:
+		if (auto Pool = GetProcessPool())
 		{
-			if (const auto OptionPtr = Scene->Commands[Index + i].GetPtr<FToastieCutsceneOption>();
-				OptionPtr && RequirementsAreMet(OptionPtr->Requirements))
-			{
-				Options.Add(*OptionPtr);
-			}
+			Pool->StopFetching();
 		}
-		Result = ExecutePlayerChoice(Id, Options);
-		return Result;
-	}
-	
-	if (TryExecuteCommand(Id, Data, &ACutscenePlayer::ExecuteSay, Result))
-		return Result;
+		return ECutscenePlayerExecuteResult::Finished;
 
-	if (TryExecuteCommand(Id, Data, &ACutscenePlayer::ExecuteEnablePlayerControl, Result))
-		return Result;
+	case EToastieCutsceneOpcode::PlayerChoice:
+		{
+			// Options are handed out by index, so presenting a choice copies nothing out of the Scene
+			const auto OptionIndices = Scene->GetChoiceOptions(Index);
+			TArray<const TArray<FToastieCutsceneReq>*, TInlineAllocator<FToastieCutsceneChoice::MaxOptions>> OptionRequirements;
+			for (const auto OptionIndex : OptionIndices)
+			{
+				OptionRequirements.Add(&Scene->GetCommand<FToastieCutsceneOption>(OptionIndex).Requirements);
+			}
 
-	if (TryExecuteCommand(Id, Data, &ACutscenePlayer::ExecuteDisablePlayerControl, Result))
-		return Result;
+			TArray<bool, TInlineAllocator<FToastieCutsceneChoice::MaxOptions>> OptionIsVisible;
+			OptionIsVisible.SetNumUninitialized(OptionIndices.Num());
+			EvaluateRequirements(OptionRequirements, OptionIsVisible);
 
-	if (TryExecuteCommand(Id, Data, &ACutscenePlayer::ExecuteWait, Result))
-		return Result;
+			auto Subsystem = bPrefetchBranches ? GetCutsceneSubsystem() : nullptr;
 
-	if (TryExecuteCommand(Id, Data, &ACutscenePlayer::ExecuteLookAt, Result))
-		return Result;
-	
-	return ECutscenePlayerExecuteResult::Finished;
-}
+			FToastieCutsceneChoice Choice;
+			Choice.CommandIndex = Index;
+			Choice.NumOptions = OptionIndices.Num();
+			for (int32 i = 0; i < OptionIndices.Num(); ++i)
+			{
+				if (OptionIsVisible[i])
+				{
+					Choice.VisibleMask |= int64(1) << i;
 
-int32 ACutscenePlayer::FindLabel(const FString& Label) const
-{
-	if (Scene)
-	{
-		for (int32 i = 0; i < Scene->Commands.Num(); ++i)
-		{
-			const auto& StructInstance = Scene->Commands[i];
-			if (const auto LabelPtr = StructInstance.GetPtr<FToastieCutsceneLabel>();
-				LabelPtr && LabelPtr->Label.Equals(Label))
+					// Any Option may be picked, start streaming the Scene each one leads to
+					const auto& Option = Scene->GetCommand<FToastieCutsceneOption>(OptionIndices[i]);
+					if (const auto BranchScene = Subsystem ? BranchScenes.Find(Option.Label) : nullptr)
+					{
+						Subsystem->PreloadScene(*BranchScene);
+					}
+				}
+			}
+			PresentedChoices.Add({ Id, Choice });
+			const auto Result = ExecutePlayerChoice(Id, Choice);
+			if (Result == ECutscenePlayerExecuteResult::Finished)
 			{
-				return i;
+				PresentedChoices.RemoveAllSwap([Id](const FPresentedChoice& Presented) { return Presented.Id == Id; }, EAllowShrinking::No);
 			}
+			return Result;
 		}
+
+	case EToastieCutsceneOpcode::Goto:
+		// Labels are resolved on import, a missing one was already reported
+		JumpToTarget(Id, Scene->GetFlow(Index).Target);
+		return ECutscenePlayerExecuteResult::Finished;
+
+	case EToastieCutsceneOpcode::Say:
+		return ExecuteSay(Id, Scene->GetCommand<FToastieCutsceneSay>(Index));
+
+	case EToastieCutsceneOpcode::EnablePlayerControl:
+		return ExecuteEnablePlayerControl(Id, Scene->GetCommand<FToastieCutsceneEnablePlayerControl>(Index));
+
+	case EToastieCutsceneOpcode::DisablePlayerControl:
+		return ExecuteDisablePlayerControl(Id, Scene->GetCommand<FToastieCutsceneDisablePlayerControl>(Index));
+
+	case EToastieCutsceneOpcode::Wait:
+		return ExecuteWait(Id, Scene->GetCommand<FToastieCutsceneWait>(Index));
+
+	case EToastieCutsceneOpcode::LookAt:
+		return ExecuteLookAt(Id, Scene->GetCommand<FToastieCutsceneLookAt>(Index));
+
+	default:
+		return ECutscenePlayerExecuteResult::Finished;
 	}
-	return -1;
 }
@@ -0,0 +1,520 @@
+#include "CutsceneProcessPool.h"
+#include "ToastieCutscenesStats.h"
+
+void FCutsceneProcessPool::Start(const UToastieCutsceneAsset& InScene, ICutsceneCommandExecutor& Executor)
+{
+	Reset();
+	Scene = &InScene;
+
+	const auto Root = AllocateProcess();
+	check(Root == RootProcess);
+	Processes[Root].EndIndex = Scene->Commands.Num() - 1;
+
+	TOASTIECUTSCENES_SCOPE(FetchCommands);
+	FetchCommands(Root, Executor, true);
+}
+
+void FCutsceneProcessPool::Reset()
+{
+	Scene = nullptr;
+	Processes.Reset();
+	Commands.Reset();
+	FreeProcesses = INDEX_NONE;
+	FreeCommands = INDEX_NONE;
+	NumProcesses = 0;
+	NumCommands = 0;
+	CommandsById.Reset();
+	IdCounter = 0;
+	QueuedCommands.Reset();
+	++Generation;
+}
+
+void FCutsceneProcessPool::Tick(const float DeltaTime, ICutsceneCommandExecutor& Executor)
+{
+	Advance(DeltaTime);
+	StartQueuedCommands(Executor);
+	Settle(Executor, true);
+}
+
+void FCutsceneProcessPool::Advance(const float DeltaTime)
+{
+	QueuedCommands.Reset();
+	++TickSerial;
+	TickDeltaTime = DeltaTime;
+	if (Scene && Processes.IsValidIndex(RootProcess))
+	{
+		AdvanceProcess(RootProcess, DeltaTime);
+	}
+}
+
+void FCutsceneProcessPool::StartQueuedCommands(ICutsceneCommandExecutor& Executor)
+{
+	INC_DWORD_STAT_BY(STAT_ToastieCutscenes_QueuedCommands, QueuedCommands.Num());
+
+	const auto StartGeneration = Generation;
+	for (int32 QueueIndex = 0; QueueIndex < QueuedCommands.Num(); ++QueueIndex)
+	{
+		// A command started earlier may have finished or replaced this one
+		const auto Queued = QueuedCommands[QueueIndex];
+		if (Commands[Queued.CommandIndex].Id != Queued.Id || Commands[Queued.CommandIndex].State != ECommandState::Queued)
+			continue;
+
+		const auto bFinished = Executor.StartCommand(Commands[Queued.CommandIndex].Index, Queued.Id);
+		if (Generation != StartGeneration)
+			return;
+
+		// The executor may have finished it already
+		if (Commands[Queued.CommandIndex].State == ECommandState::Queued)
+		{
+			Commands[Queued.CommandIndex].State = bFinished ? ECommandState::Finished : ECommandState::Running;
+		}
+	}
+	QueuedCommands.Reset();
+}
+
+bool FCutsceneProcessPool::Settle(ICutsceneCommandExecutor& Executor, const bool bOnGameThread)
+{
+	if (Scene && Processes.IsValidIndex(RootProcess))
+	{
+		return SettleProcess(RootProcess, Executor, bOnGameThread);
+	}
+	return true;
+}
+
+bool FCutsceneProcessPool::IsFinished() const
+{
+	return !Scene || !Processes.IsValidIndex(RootProcess) || IsProcessFinished(RootProcess);
+}
+
+bool FCutsceneProcessPool::IsWaiting(float& WakeDelay) const
+{
+	return !IsFinished() && IsProcessWaiting(RootProcess, WakeDelay);
+}
+
+void FCutsceneProcessPool::FinishCommand(const int32 Id)
+{
+	if (const auto CommandIndex = CommandsById.Find(Id); CommandIndex)
+	{
+		Commands[*CommandIndex].State = ECommandState::Finished;
+	}
+}
+
+int32 FCutsceneProcessPool::GetCommandIndex(const int32 Id) const
+{
+	const auto CommandIndex = CommandsById.Find(Id);
+	return CommandIndex ? Commands[*CommandIndex].Index : INDEX_NONE;
+}
+
+bool FCutsceneProcessPool::ContinueFrom(const int32 Id, const int32 Index)
+{
+	if (const auto CommandIndex = CommandsById.Find(Id); CommandIndex)
+	{
+		Processes[Commands[*CommandIndex].Process].CurrentIndex = Index;
+		return true;
+	}
+	return false;
+}
+
+void FCutsceneProcessPool::StopFetching()
+{
+	// Released records are reinitialized when they're reused, so they can be included
+	for (auto& Process : Processes)
+	{
+		Process.CurrentIndex = INT32_MAX;
+	}
+}
+
+SIZE_T FCutsceneProcessPool::GetAllocatedSize() const
+{
+	return Processes.GetAllocatedSize()
+		+ Commands.GetAllocatedSize()
+		+ CommandsById.GetAllocatedSize()
+		+ QueuedCommands.GetAllocatedSize();
+}
+
+int32 FCutsceneProcessPool::AllocateProcess()
+{
+	++NumProcesses;
+	if (FreeProcesses == INDEX_NONE)
+		return Processes.AddDefaulted();
+
+	const auto ProcessIndex = FreeProcesses;
+	FreeProcesses = Processes[ProcessIndex].NextSibling;
+	Processes[ProcessIndex] = FProcessRecord();
+	return ProcessIndex;
+}
+
+void FCutsceneProcessPool::ReleaseProcess(const int32 ProcessIndex)
+{
+	--NumProcesses;
+	Processes[ProcessIndex].NextSibling = FreeProcesses;
+	FreeProcesses = ProcessIndex;
+}
+
+int32 FCutsceneProcessPool::AllocateCommand()
+{
+	++NumCommands;
+	if (FreeCommands == INDEX_NONE)
+		return Commands.AddDefaulted();
+
+	const auto CommandIndex = FreeCommands;
+	FreeCommands = Commands[CommandIndex].Next;
+	Commands[CommandIndex] = FCommandRecord();
+	return CommandIndex;
+}
+
+void FCutsceneProcessPool::ReleaseCommand(const int32 CommandIndex)
+{
+	--NumCommands;
+	CommandsById.Remove(Commands[CommandIndex].Id);
+	Commands[CommandIndex].Next = FreeCommands;
+	FreeCommands = CommandIndex;
+}
+
+void FCutsceneProcessPool::AdvanceProcess(const int32 ProcessIndex, const float DeltaTime)
+{
+	// Advancing doesn't add records, so references stay valid
+	auto& Process = Processes[ProcessIndex];
+	if (Process.Delay > 0.0f)
+	{
+		// Nothing below a delayed process is settled either
+		Process.Delay -= DeltaTime;
+		Process.SettledTick = TickSerial;
+		return;
+	}
+
+	bool bAtLeastOneBlockingChild = false;
+	for (auto Child = Process.FirstChild; Child != INDEX_NONE; Child = Processes[Child].NextSibling)
+	{
+		AdvanceProcess(Child, DeltaTime);
+		bAtLeastOneBlockingChild |= Processes[Child].bBlocking;
+	}
+
+	if (bAtLeastOneBlockingChild)
+	{
+		// Settle advances the commands instead if every blocking child finishes this tick
+		return;
+	}
+
+	AdvanceCommands(ProcessIndex, DeltaTime, true);
+}
+
+bool FCutsceneProcessPool::AdvanceCommands(const int32 ProcessIndex, const float DeltaTime, const bool bQueue)
+{
+	// Counts down delays, returns true if any command is ready to start
+	Processes[ProcessIndex].AdvancedTick = TickSerial;
+	bool bAnyQueued = false;
+	for (auto CommandIndex = Processes[ProcessIndex].FirstCommand; CommandIndex != INDEX_NONE; CommandIndex = Commands[CommandIndex].Next)
+	{
+		auto& Command = Commands[CommandIndex];
+		if (Command.State == ECommandState::Delayed)
+		{
+			Command.DelayedTimeRemaining -= DeltaTime;
+			if (Command.DelayedTimeRemaining <= 0.0f)
+			{
+				Command.State = ECommandState::Queued;
+			}
+		}
+
+		if (Command.State == ECommandState::Queued)
+		{
+			bAnyQueued = true;
+			if (bQueue)
+			{
+				QueuedCommands.Add({ CommandIndex, Command.Id });
+			}
+		}
+	}
+	return bAnyQueued;
+}
+
+bool FCutsceneProcessPool::StartProcessCommands(const int32 ProcessIndex, ICutsceneCommandExecutor& Executor)
+{
+	// Starting a command doesn't add records, the list only changes if the executor resets the pool
+	const auto StartGeneration = Generation;
+	for (auto CommandIndex = Processes[ProcessIndex].FirstCommand; CommandIndex != INDEX_NONE; CommandIndex = Commands[CommandIndex].Next)
+	{
+		if (Commands[CommandIndex].State != ECommandState::Queued)
+			continue;
+
+		INC_DWORD_STAT(STAT_ToastieCutscenes_QueuedCommands);
+		const auto bFinished = Executor.StartCommand(Commands[CommandIndex].Index, Commands[CommandIndex].Id);
+		if (Generation != StartGeneration)
+			return false;
+
+		// The executor may have finished it already
+		if (Commands[CommandIndex].State == ECommandState::Queued)
+		{
+			Commands[CommandIndex].State = bFinished ? ECommandState::Finished : ECommandState::Running;
+		}
+	}
+	return true;
+}
+
+bool FCutsceneProcessPool::SettleProcess(const int32 ProcessIndex, ICutsceneCommandExecutor& Executor, const bool bOnGameThread)
+{
+	// Records are accessed by index throughout, fetching can grow the arrays
+	if (Processes[ProcessIndex].SettledTick == TickSerial)
+		return true;
+
+	const auto SettleGeneration = Generation;
+	const auto Resume = Processes[ProcessIndex].Resume;
+	Processes[ProcessIndex].Resume = ESettleResume::None;
+
+	for (auto Child = Processes[ProcessIndex].FirstChild; Child != INDEX_NONE; Child = Processes[Child].NextSibling)
+	{
+		if (!SettleProcess(Child, Executor, bOnGameThread))
+			return false;
+		if (Generation != SettleGeneration)
+			return true;
+	}
+
+	auto bStartCommands = Resume == ESettleResume::StartCommands;
+	if (Resume == ESettleResume::None)
+	{
+		// Clear the children that finished, once all of them have settled
+		bool bAtLeastOneBlockingChild = false;
+		int32 PreviousChild = INDEX_NONE;
+		int32 Child = Processes[ProcessIndex].FirstChild;
+		while (Child != INDEX_NONE)
+		{
+			bAtLeastOneBlockingChild |= Processes[Child].bBlocking;
+
+			const auto NextChild = Processes[Child].NextSibling;
+			if (IsProcessFinished(Child))
+			{
+				auto& Process = Processes[ProcessIndex];
+				if (PreviousChild == INDEX_NONE)
+					Process.FirstChild = NextChild;
+				else
+					Processes[PreviousChild].NextSibling = NextChild;
+				if (Process.LastChild == Child)
+					Process.LastChild = PreviousChild;
+				ReleaseProcess(Child);
+			}
+			else
+			{
+				PreviousChild = Child;
+			}
+			Child = NextChild;
+		}
+
+		if (Processes[ProcessIndex].FirstChild != INDEX_NONE && bAtLeastOneBlockingChild)
+		{
+			Processes[ProcessIndex].SettledTick = TickSerial;
+			return true;
+		}
+
+		// The children that held back this process's commands in Advance finished this tick, its commands tick now
+		bStartCommands = Processes[ProcessIndex].AdvancedTick != TickSerial && AdvanceCommands(ProcessIndex, TickDeltaTime, false);
+		if (bStartCommands && !bOnGameThread)
+		{
+			Processes[ProcessIndex].Resume = ESettleResume::StartCommands;
+			return false;
+		}
+	}
+
+	if (bStartCommands && !StartProcessCommands(ProcessIndex, Executor))
+		return true;
+
+	const auto bSettleCommands = Resume == ESettleResume::None || Resume == ESettleResume::StartCommands;
+	if (bSettleCommands)
+	{
+		RemoveFinishedCommands(ProcessIndex);
+	}
+
+	// If all current commands have finished,
+	// fetch new commands
+	if (Resume == ESettleResume::Fetch || (bSettleCommands && IsFinishedCurrentActions(ProcessIndex)))
+	{
+		TOASTIECUTSCENES_SCOPE(FetchCommands);
+		if (!FetchCommands(ProcessIndex, Executor, bOnGameThread))
+			return false;
+		if (Generation != SettleGeneration)
+			return true;
+	}
+
+	Processes[ProcessIndex].SettledTick = TickSerial;
+	return true;
+}
+
+bool FCutsceneProcessPool::FetchCommands(const int32 ProcessIndex, ICutsceneCommandExecutor& Executor, const bool bOnGameThread)
+{
+	const auto FetchGeneration = Generation;
+	while (Scene
+		&& Scene->Commands.IsValidIndex(Processes[ProcessIndex].CurrentIndex)
+		&& Processes[ProcessIndex].CurrentIndex <= Processes[ProcessIndex].EndIndex)
+	{
+		const auto CurrentIndex = Processes[ProcessIndex].CurrentIndex;
+		const auto Opcode = Scene->GetOpcode(CurrentIndex);
+		if (Opcode == EToastieCutsceneOpcode::Invalid)
+		{
+			// Invalid command, ignored
+			++Processes[ProcessIndex].CurrentIndex;
+			continue;
+		}
+
+		const auto& Command = Scene->GetCommand<FToastieCutsceneCommandBase>(CurrentIndex);
+		if (!Command.Requirements.IsEmpty() && !bOnGameThread && !Executor.CanCheckRequirementsOnAnyThread())
+		{
+			// Fetching picks up from this command on the game thread
+			Processes[ProcessIndex].Resume = ESettleResume::Fetch;
+			return false;
+		}
+
+		const auto bRequirementsMet = Command.Requirements.IsEmpty() || Executor.CheckRequirements(Command.Requirements);
+		if (Generation != FetchGeneration)
+			return true;
+
+		// Blocks and PlayerChoices continue past everything they contain
+		const auto& Node = Scene->GetFlow(CurrentIndex);
+		Processes[ProcessIndex].CurrentIndex = Node.Next;
+
+		if (Opcode == EToastieCutsceneOpcode::Block)
+		{
+			if (bRequirementsMet)
+			{
+				const auto& Block = Scene->GetCommand<FToastieCutsceneBlock>(CurrentIndex);
+				const auto Child = AllocateProcess();
+				auto& ChildProcess = Processes[Child];
+				ChildProcess.CurrentIndex = CurrentIndex + 1;
+				ChildProcess.EndIndex = Node.Last;
+				ChildProcess.bConcurrent = Block.Type == EToastieCutsceneBlockType::Concurrent;
+				ChildProcess.Delay = Block.Delay;
+				ChildProcess.bBlocking = !Block.bDoNotBlock;
+
+				auto& Process = Processes[ProcessIndex];
+				if (Process.LastChild == INDEX_NONE)
+					Process.FirstChild = Child;
+				else
+					Processes[Process.LastChild].NextSibling = Child;
+				Process.LastChild = Child;
+
+				if (!FetchCommands(Child, Executor, bOnGameThread))
+				{
+					// The child finishes fetching first, then this process continues if it would have
+					Processes[ProcessIndex].Resume = Processes[ProcessIndex].bConcurrent || Command.bDoNotBlock
+						? ESettleResume::Fetch
+						: ESettleResume::Children;
+					return false;
+				}
+				if (Generation != FetchGeneration)
+					return true;
+
+				// A new process starts ticking on the next tick
+				Processes[Child].SettledTick = TickSerial;
+			}
+		}
+		else if (bRequirementsMet)
+		{
+			// Add this command to the active command list
+			const auto CommandIndex = AllocateCommand();
+			auto& State = Commands[CommandIndex];
+			State.Id = ++IdCounter;
+			State.Index = CurrentIndex;
+			State.Process = ProcessIndex;
+			State.DelayedTimeRemaining = Command.Delay;
+			State.State = Command.Delay > 0.0f ? ECommandState::Delayed : ECommandState::Queued;
+			State.bBlocking = !Command.bDoNotBlock;
+			CommandsById.Add(State.Id, CommandIndex);
+
+			auto& Process = Processes[ProcessIndex];
+			if (Process.LastCommand == INDEX_NONE)
+				Process.FirstCommand = CommandIndex;
+			else
+				Commands[Process.LastCommand].Next = CommandIndex;
+			Process.LastCommand = CommandIndex;
+		}
+
+		if (Processes[ProcessIndex].bConcurrent || Command.bDoNotBlock)
+			continue;
+
+		// All possible commands have been added to the queue
+		// Let them tick and finish before fetching more commands
+		return true;
+	}
+	return true;
+}
+
+void FCutsceneProcessPool::RemoveFinishedCommands(const int32 ProcessIndex)
+{
+	auto& Process = Processes[ProcessIndex];
+	int32 PreviousCommand = INDEX_NONE;
+	int32 CommandIndex = Process.FirstCommand;
+	while (CommandIndex != INDEX_NONE)
+	{
+		const auto NextCommand = Commands[CommandIndex].Next;
+		if (Commands[CommandIndex].State == ECommandState::Finished)
+		{
+			if (PreviousCommand == INDEX_NONE)
+				Process.FirstCommand = NextCommand;
+			else
+				Commands[PreviousCommand].Next = NextCommand;
+			if (Process.LastCommand == CommandIndex)
+				Process.LastCommand = PreviousCommand;
+			ReleaseCommand(CommandIndex);
+		}
+		else
+		{
+			PreviousCommand = CommandIndex;
+		}
+		CommandIndex = NextCommand;
+	}
+}
+
+bool FCutsceneProcessPool::IsFinishedCurrentActions(const int32 ProcessIndex) const
+{
+	for (auto CommandIndex = Processes[ProcessIndex].FirstCommand; CommandIndex != INDEX_NONE; CommandIndex = Commands[CommandIndex].Next)
+	{
+		const auto& Command = Commands[CommandIndex];
+		if (Command.bBlocking &&
+			Command.State != ECommandState::Finished)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FCutsceneProcessPool::IsProcessFinished(const int32 ProcessIndex) const
+{
+	const auto& Process = Processes[ProcessIndex];
+	return !Scene || (Process.FirstCommand == INDEX_NONE && Process.FirstChild == INDEX_NONE);
+}
+
+bool FCutsceneProcessPool::IsProcessWaiting(const int32 ProcessIndex, float& WakeDelay) const
+{
+	const auto& Process = Processes[ProcessIndex];
+	if (Process.Delay > 0.0f)
+	{
+		// Nothing below this process runs until its delay has passed
+		WakeDelay = FMath::Min(WakeDelay, Process.Delay);
+		return true;
+	}
+
+	bool bAtLeastOneBlockingChild = false;
+	for (auto Child = Process.FirstChild; Child != INDEX_NONE; Child = Processes[Child].NextSibling)
+	{
+		if (IsProcessFinished(Child) || !IsProcessWaiting(Child, WakeDelay))
+			return false;
+		bAtLeastOneBlockingChild |= Processes[Child].bBlocking;
+	}
+
+	// Commands of this process don't tick while a child blocks them
+	if (bAtLeastOneBlockingChild)
+		return true;
+
+	for (auto CommandIndex = Process.FirstCommand; CommandIndex != INDEX_NONE; CommandIndex = Commands[CommandIndex].Next)
+	{
+		const auto& Command = Commands[CommandIndex];
+		if (Command.State == ECommandState::Queued || Command.State == ECommandState::Finished)
+			return false;
+		if (Command.State == ECommandState::Delayed)
+			WakeDelay = FMath::Min(WakeDelay, Command.DelayedTimeRemaining);
+	}
+
+	// Fetching may still have commands left to add
+	return !(IsFinishedCurrentActions(ProcessIndex)
+		&& Scene->Commands.IsValidIndex(Process.CurrentIndex)
+		&& Process.CurrentIndex <= Process.EndIndex);
+}
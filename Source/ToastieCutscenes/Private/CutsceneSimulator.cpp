@@ -0,0 +1,175 @@
+#include "CutsceneSimulator.h"
+#include "ToastieCutsceneValueProvider.h"
+
+FCutsceneSimulator::FCutsceneSimulator(const FCutsceneSimulationSettings& InSettings)
+	: Settings(InSettings)
+{
+	// A zero interval would never advance virtual time
+	Settings.TickInterval = FMath::Max(Settings.TickInterval, KINDA_SMALL_NUMBER);
+}
+
+FCutsceneSimulationResult FCutsceneSimulator::Run(const UToastieCutsceneAsset& InScene)
+{
+	FCutsceneSimulationResult RunResult;
+	Scene = &InScene;
+	Result = &RunResult;
+	RunningCommands.Reset();
+	ChoiceStream.Initialize(Settings.Seed);
+
+	ProcessPool.Start(InScene, *this);
+	while (!ProcessPool.IsFinished() && RunResult.SimulatedTime < Settings.MaxTime)
+	{
+		// Commands that ran out of time finish before the tick, as if Blueprint finished them between frames
+		TickRunningCommands(Settings.TickInterval);
+		ProcessPool.Tick(Settings.TickInterval, *this);
+
+		++RunResult.NumTicks;
+		RunResult.SimulatedTime += Settings.TickInterval;
+		RunResult.PeakAllocatedSize = FMath::Max(RunResult.PeakAllocatedSize, GetAllocatedSize());
+	}
+	RunResult.bFinished = ProcessPool.IsFinished();
+
+	ProcessPool.Reset();
+	RunningCommands.Reset();
+	Scene = nullptr;
+	Result = nullptr;
+	return RunResult;
+}
+
+SIZE_T FCutsceneSimulator::GetAllocatedSize() const
+{
+	return ProcessPool.GetAllocatedSize() + RunningCommands.GetAllocatedSize();
+}
+
+bool FCutsceneSimulator::CheckRequirements(const TArray<FToastieCutsceneReq>& Reqs)
+{
+	return Reqs.IsEmpty() || IToastieCutsceneValueProvider::AreRequirementsMet(Settings.ValueProvider, Reqs);
+}
+
+bool FCutsceneSimulator::CanCheckRequirementsOnAnyThread() const
+{
+	return !Settings.ValueProvider || Settings.ValueProvider->CanReadValuesOnAnyThread();
+}
+
+bool FCutsceneSimulator::StartCommand(const int32 Index, const int32 Id)
+{
+	++Result->NumCommands;
+	if (Settings.bRecordCommands)
+	{
+		Result->StartedCommands.Add(Index);
+	}
+
+	float Duration = 0.0f;
+	switch (Scene->GetOpcode(Index))
+	{
+	case EToastieCutsceneOpcode::Exit:
+		ProcessPool.StopFetching();
+		return true;
+
+	case EToastieCutsceneOpcode::Goto:
+		JumpToTarget(Id, Scene->GetFlow(Index).Target);
+		return true;
+
+	case EToastieCutsceneOpcode::PlayerChoice:
+		return StartPlayerChoice(Index, Id);
+
+	case EToastieCutsceneOpcode::Say:
+		{
+			const auto& Say = Scene->GetCommand<FToastieCutsceneSay>(Index);
+			Duration = Say.Time > 0.0 ? static_cast<float>(Say.Time) : Settings.SayDuration;
+			break;
+		}
+
+	case EToastieCutsceneOpcode::Wait:
+		Duration = static_cast<float>(Scene->GetCommand<FToastieCutsceneWait>(Index).Time);
+		break;
+
+	case EToastieCutsceneOpcode::LookAt:
+		Duration = Settings.LookAtDuration;
+		break;
+
+	case EToastieCutsceneOpcode::Custom:
+		Duration = Settings.CustomDuration;
+		break;
+
+	default:
+		return true;
+	}
+
+	if (Duration <= 0.0f)
+		return true;
+
+	auto& Running = RunningCommands.AddDefaulted_GetRef();
+	Running.Id = Id;
+	Running.TimeRemaining = Duration;
+	return false;
+}
+
+void FCutsceneSimulator::TickRunningCommands(const float DeltaTime)
+{
+	// Finishing a command doesn't start another one, so the list can be compacted in place
+	int32 NumKept = 0;
+	for (int32 i = 0; i < RunningCommands.Num(); ++i)
+	{
+		const auto Running = RunningCommands[i];
+		if (Running.TimeRemaining > DeltaTime)
+		{
+			RunningCommands[NumKept] = Running;
+			RunningCommands[NumKept].TimeRemaining -= DeltaTime;
+			++NumKept;
+			continue;
+		}
+
+		if (Running.bChoice)
+		{
+			JumpToTarget(Running.Id, Running.ChosenTarget);
+		}
+		ProcessPool.FinishCommand(Running.Id);
+	}
+	RunningCommands.SetNum(NumKept, EAllowShrinking::No);
+}
+
+bool FCutsceneSimulator::StartPlayerChoice(const int32 Index, const int32 Id)
+{
+	++Result->NumChoices;
+
+	TArray<int32, TInlineAllocator<8>> VisibleTargets;
+	for (const auto OptionIndex : Scene->GetChoiceOptions(Index))
+	{
+		if (CheckRequirements(Scene->GetCommand<FToastieCutsceneOption>(OptionIndex).Requirements))
+		{
+			VisibleTargets.Add(Scene->GetFlow(OptionIndex).Target);
+		}
+	}
+
+	// With nothing to pick, the choice falls through to the next command
+	if (VisibleTargets.IsEmpty())
+		return true;
+
+	const auto ChosenTarget = VisibleTargets[ChoiceStream.RandHelper(VisibleTargets.Num())];
+	if (Settings.PlayerChoiceDuration <= 0.0f)
+	{
+		JumpToTarget(Id, ChosenTarget);
+		return true;
+	}
+
+	auto& Running = RunningCommands.AddDefaulted_GetRef();
+	Running.Id = Id;
+	Running.TimeRemaining = Settings.PlayerChoiceDuration;
+	Running.ChosenTarget = ChosenTarget;
+	Running.bChoice = true;
+	return false;
+}
+
+void FCutsceneSimulator::JumpToTarget(const int32 Id, const int32 Target)
+{
+	// Targets of missing Labels are skipped, a simulation shouldn't stall on them
+	if (Target == FToastieCutsceneFlowNode::ExitTarget)
+	{
+		ProcessPool.StopFetching();
+	}
+	else if (Target >= 0)
+	{
+		ProcessPool.ContinueFrom(Id, Target);
+	}
+}
@@ -1,5 +1,45 @@
 #include "ToastieCutsceneAsset.h"
+#include "ToastieCutscenesStats.h"
 #include "EditorFramework/AssetImportData.h"
+#include "Serialization/CustomVersion.h"
+
+namespace
+{
+	struct FToastieCutsceneCustomVersion
+	{
+		enum Type
+		{
+			BeforeCustomVersionWasAdded = 0,
+
+			// Cooked assets store Commands as a packed blob
+			PackedCookedCommands,
+
+			VersionPlusOne,
+			LatestVersion = VersionPlusOne - 1
+		};
+
+		static const FGuid GUID;
+	};
+
+	const FGuid FToastieCutsceneCustomVersion::GUID(0x5E3C7A41, 0x9B2D4F18, 0xA6C30E57, 0x1D84B2F9);
+	FCustomVersionRegistration GRegisterToastieCutsceneCustomVersion(FToastieCutsceneCustomVersion::GUID, FToastieCutsceneCustomVersion::LatestVersion, TEXT("ToastieCutsceneVer"));
+}
+
+const FName FToastieCutsceneOption::ExitLabel(TEXT("Exit"));
+
+bool FToastieCutsceneReq::IsMet(const int32 CurrentValue) const
+{
+	switch (Op)
+	{
+	case EToastieCutsceneOperator::LessThan:			return CurrentValue < Value;
+	case EToastieCutsceneOperator::LessThanOrEqual:		return CurrentValue <= Value;
+	case EToastieCutsceneOperator::Equal:				return CurrentValue == Value;
+	case EToastieCutsceneOperator::GreaterThan:			return CurrentValue > Value;
+	case EToastieCutsceneOperator::GreaterThanOrEqual:	return CurrentValue >= Value;
+	case EToastieCutsceneOperator::NotEqual:			return CurrentValue != Value;
+	default:											return false;
+	}
+}
 
 void UToastieCutsceneAsset::PostInitProperties()
 {
@@ -12,6 +52,313 @@ void UToastieCutsceneAsset::PostInitProperties()
 	Super::PostInitProperties();
 }
 
+void UToastieCutsceneAsset::Serialize(FArchive& Ar)
+{
+	Ar.UsingCustomVersion(FToastieCutsceneCustomVersion::GUID);
+
+	// Keep Commands out of tagged serialization while cooking, they are written packed after it
+	const bool bSavePacked = Ar.IsSaving() && Ar.IsCooking();
+	TArray<FInstancedStruct> EditableCommands;
+	if (bSavePacked)
+	{
+		EditableCommands = MoveTemp(Commands);
+	}
+
+	Super::Serialize(Ar);
+
+	if (Ar.CustomVer(FToastieCutsceneCustomVersion::GUID) >= FToastieCutsceneCustomVersion::PackedCookedCommands)
+	{
+		bool bPacked = bSavePacked;
+		Ar << bPacked;
+		if (bPacked && Ar.IsSaving())
+		{
+			SavePackedCommands(Ar, EditableCommands);
+		}
+		else if (bPacked && Ar.IsLoading())
+		{
+			LoadPackedCommands(Ar);
+		}
+	}
+
+	if (bSavePacked)
+	{
+		Commands = MoveTemp(EditableCommands);
+	}
+}
+
+void UToastieCutsceneAsset::SavePackedCommands(FArchive& Ar, TArray<FInstancedStruct>& InCommands)
+{
+	// Each command type is written once, commands refer to it by index
+	TArray<UScriptStruct*> CommandTypes;
+	TArray<int32> TypeIndices;
+	TypeIndices.Reserve(InCommands.Num());
+	for (const auto& Command : InCommands)
+	{
+		TypeIndices.Add(CommandTypes.AddUnique(const_cast<UScriptStruct*>(Command.GetScriptStruct())));
+	}
+	Ar << CommandTypes;
+
+	int32 NumCommands = InCommands.Num();
+	Ar << NumCommands;
+	for (int32 i = 0; i < NumCommands; ++i)
+	{
+		Ar << TypeIndices[i];
+		if (const auto CommandType = CommandTypes[TypeIndices[i]])
+		{
+			CommandType->SerializeBin(Ar, InCommands[i].GetMutableMemory());
+		}
+	}
+}
+
+void UToastieCutsceneAsset::LoadPackedCommands(FArchive& Ar)
+{
+	TArray<UScriptStruct*> CommandTypes;
+	Ar << CommandTypes;
+
+	int32 NumCommands = 0;
+	Ar << NumCommands;
+	Commands.Reset(NumCommands);
+	Commands.SetNum(NumCommands);
+	for (int32 i = 0; i < NumCommands && !Ar.IsError(); ++i)
+	{
+		int32 TypeIndex = INDEX_NONE;
+		Ar << TypeIndex;
+		if (!CommandTypes.IsValidIndex(TypeIndex))
+		{
+			Ar.SetError();
+			break;
+		}
+
+		if (const auto CommandType = CommandTypes[TypeIndex])
+		{
+			Commands[i].InitializeAs(CommandType);
+			CommandType->SerializeBin(Ar, Commands[i].GetMutableMemory());
+		}
+	}
+}
+
+void UToastieCutsceneAsset::PostLoad()
+{
+	Super::PostLoad();
+
+	if (RuntimeDataVersion < CurrentRuntimeDataVersion)
+	{
+		BuildRuntimeData();
+	}
+}
+
+#if WITH_EDITOR
+void UToastieCutsceneAsset::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	// Commands can be edited in the details panel, keep the derived data in sync
+	BuildRuntimeData();
+}
+#endif
+
+void UToastieCutsceneAsset::BuildRuntimeData()
+{
+	Opcodes.Reset(Commands.Num());
+	for (const auto& Command : Commands)
+	{
+		Opcodes.Add(FindOpcode(Command));
+	}
+
+	LabelIndices.Reset();
+	for (int32 i = 0; i < Commands.Num(); ++i)
+	{
+		if (const auto LabelPtr = Commands[i].GetPtr<FToastieCutsceneLabel>();
+			LabelPtr)
+		{
+			// The first Label with a name wins
+			LabelIndices.FindOrAdd(LabelPtr->Label, i);
+		}
+	}
+
+	TArray<FString> Errors;
+	if (!CompileFlow(Commands, Flow, ChoiceOptions, &Errors))
+	{
+		for (const auto& Error : Errors)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("TCS: %s in %s"), *Error, *GetName());
+		}
+	}
+
+	RuntimeDataVersion = CurrentRuntimeDataVersion;
+}
+
+bool UToastieCutsceneAsset::CompileFlow(TConstArrayView<FInstancedStruct> InCommands, TArray<FToastieCutsceneFlowNode>& OutFlow,
+	TArray<int32>& OutChoiceOptions, TArray<FString>* OutErrors)
+{
+	bool bValid = true;
+	auto AddError = [&bValid, OutErrors](FString&& Error)
+	{
+		bValid = false;
+		if (OutErrors)
+		{
+			OutErrors->Add(MoveTemp(Error));
+		}
+	};
+
+	// The first Label with a name wins
+	TMap<FName, int32> Labels;
+	for (int32 i = 0; i < InCommands.Num(); ++i)
+	{
+		if (const auto LabelPtr = InCommands[i].GetPtr<FToastieCutsceneLabel>(); LabelPtr)
+		{
+			Labels.FindOrAdd(LabelPtr->Label, i);
+		}
+	}
+
+	auto ResolveLabel = [&](const int32 Index, const FName Label, const TCHAR* CommandName)
+	{
+		if (const auto LabelIndex = Labels.Find(Label); LabelIndex)
+			return *LabelIndex + 1;
+
+		AddError(FString::Printf(TEXT("%s at command %d jumps to unknown Label %s"), CommandName, Index, *Label.ToString()));
+		return static_cast<int32>(INDEX_NONE);
+	};
+
+	// Blocks enclosing the current command, innermost last
+	struct FOpenBlock
+	{
+		int32 Index;
+		int32 Last;
+		bool bPlayerChoice;
+	};
+	TArray<FOpenBlock, TInlineAllocator<16>> OpenBlocks;
+
+	OutFlow.SetNum(InCommands.Num());
+	for (int32 i = 0; i < InCommands.Num(); ++i)
+	{
+		while (!OpenBlocks.IsEmpty() && OpenBlocks.Last().Last < i)
+		{
+			OpenBlocks.Pop(EAllowShrinking::No);
+		}
+
+		auto& Node = OutFlow[i];
+		Node = FToastieCutsceneFlowNode();
+		Node.Next = i + 1;
+		Node.Last = i;
+
+		const auto& Command = InCommands[i];
+		if (const auto BlockPtr = Command.GetPtr<FToastieCutsceneBlock>(); BlockPtr)
+		{
+			// A Block can't reach past the Block it's in
+			const auto ParentLast = OpenBlocks.IsEmpty() ? InCommands.Num() - 1 : OpenBlocks.Last().Last;
+			const auto CommandCount = FMath::Clamp(BlockPtr->CommandCount, 0, ParentLast - i);
+			if (CommandCount != BlockPtr->CommandCount)
+			{
+				AddError(FString::Printf(TEXT("Block at command %d holds %d commands but only %d follow it"), i, BlockPtr->CommandCount, ParentLast - i));
+			}
+
+			Node.Last = i + CommandCount;
+			Node.Next = Node.Last + 1;
+			OpenBlocks.Add({ i, Node.Last, BlockPtr->Type == EToastieCutsceneBlockType::PlayerChoice });
+		}
+		else if (const auto OptionPtr = Command.GetPtr<FToastieCutsceneOption>(); OptionPtr)
+		{
+			if (OpenBlocks.IsEmpty() || !OpenBlocks.Last().bPlayerChoice)
+			{
+				AddError(FString::Printf(TEXT("Option at command %d isn't in a PlayerChoice"), i));
+			}
+
+			Node.Target = OptionPtr->Label == FToastieCutsceneOption::ExitLabel
+				? FToastieCutsceneFlowNode::ExitTarget
+				: ResolveLabel(i, OptionPtr->Label, TEXT("Option"));
+		}
+		else if (const auto GotoPtr = Command.GetPtr<FToastieCutsceneGoto>(); GotoPtr)
+		{
+			Node.Target = ResolveLabel(i, GotoPtr->Label, TEXT("Goto"));
+		}
+	}
+
+	// Options of each PlayerChoice are its direct children, kept together so a choice reads them as one range
+	OutChoiceOptions.Reset();
+	for (int32 i = 0; i < InCommands.Num(); ++i)
+	{
+		const auto BlockPtr = InCommands[i].GetPtr<FToastieCutsceneBlock>();
+		if (!BlockPtr || BlockPtr->Type != EToastieCutsceneBlockType::PlayerChoice)
+			continue;
+
+		auto& Node = OutFlow[i];
+		Node.FirstOption = OutChoiceOptions.Num();
+		for (auto Child = i + 1; Child <= Node.Last; Child = OutFlow[Child].Next)
+		{
+			if (InCommands[Child].GetPtr<FToastieCutsceneOption>())
+			{
+				OutChoiceOptions.Add(Child);
+			}
+		}
+		Node.NumOptions = OutChoiceOptions.Num() - Node.FirstOption;
+
+		// Visibility of a choice's Options is a 64 bit mask
+		if (Node.NumOptions > FToastieCutsceneChoice::MaxOptions)
+		{
+			AddError(FString::Printf(TEXT("PlayerChoice at command %d has %d Options, only the first %d are used"), i, Node.NumOptions, FToastieCutsceneChoice::MaxOptions));
+			OutChoiceOptions.SetNum(Node.FirstOption + FToastieCutsceneChoice::MaxOptions, EAllowShrinking::No);
+			Node.NumOptions = FToastieCutsceneChoice::MaxOptions;
+		}
+	}
+
+	return bValid;
+}
+
+EToastieCutsceneOpcode UToastieCutsceneAsset::FindOpcode(const FInstancedStruct& Command)
+{
+	const auto CommandType = Command.GetScriptStruct();
+	if (!CommandType || !CommandType->IsChildOf(FToastieCutsceneCommandBase::StaticStruct()))
+	{
+		return EToastieCutsceneOpcode::Invalid;
+	}
+
+	if (CommandType->IsChildOf(FToastieCutsceneExit::StaticStruct()))
+	{
+		return EToastieCutsceneOpcode::Exit;
+	}
+	if (CommandType->IsChildOf(FToastieCutsceneBlock::StaticStruct()))
+	{
+		return Command.Get<FToastieCutsceneBlock>().Type == EToastieCutsceneBlockType::PlayerChoice
+			? EToastieCutsceneOpcode::PlayerChoice
+			: EToastieCutsceneOpcode::Block;
+	}
+
+	struct FOpcodeType
+	{
+		const UScriptStruct* CommandType;
+		EToastieCutsceneOpcode Opcode;
+	};
+
+	const FOpcodeType OpcodeTypes[] =
+	{
+		{ FToastieCutsceneGoto::StaticStruct(), EToastieCutsceneOpcode::Goto },
+		{ FToastieCutsceneSay::StaticStruct(), EToastieCutsceneOpcode::Say },
+		{ FToastieCutsceneEnablePlayerControl::StaticStruct(), EToastieCutsceneOpcode::EnablePlayerControl },
+		{ FToastieCutsceneDisablePlayerControl::StaticStruct(), EToastieCutsceneOpcode::DisablePlayerControl },
+		{ FToastieCutsceneWait::StaticStruct(), EToastieCutsceneOpcode::Wait },
+		{ FToastieCutsceneLookAt::StaticStruct(), EToastieCutsceneOpcode::LookAt },
+		{ FToastieCutsceneLabel::StaticStruct(), EToastieCutsceneOpcode::Label },
+		{ FToastieCutsceneOption::StaticStruct(), EToastieCutsceneOpcode::Option }
+	};
+
+	for (const auto& OpcodeType : OpcodeTypes)
+	{
+		if (CommandType->IsChildOf(OpcodeType.CommandType))
+		{
+			return OpcodeType.Opcode;
+		}
+	}
+	return EToastieCutsceneOpcode::Custom;
+}
+
+int32 UToastieCutsceneAsset::FindLabel(const FName Label) const
+{
+	TOASTIECUTSCENES_SCOPE(FindLabel);
+	const auto IndexPtr = LabelIndices.Find(Label);
+	return IndexPtr ? *IndexPtr : INDEX_NONE;
+}
+
 void UToastieCutsceneAsset::GetAssetRegistryTags(FAssetRegistryTagsContext Context) const
 {
 #if WITH_EDITORONLY_DATA
@@ -0,0 +1,365 @@
+#include "ToastieCutsceneSubsystem.h"
+#include "CutscenePlayer.h"
+#include "ToastieCutscenesStats.h"
+#include "Engine/World.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<bool> CVarToastieCutscenesParallelTick(
+	TEXT("tcs.ParallelTick"),
+	false,
+	TEXT("Advance and settle the commands of playing cutscenes on worker threads. Commands always start on the game thread."));
+
+void UToastieCutsceneSubsystem::PreloadScene(const TSoftObjectPtr<UToastieCutsceneAsset>& Scene)
+{
+	if (!Scene.IsNull())
+	{
+		FindOrStreamScene(Scene.ToSoftObjectPath());
+	}
+}
+
+void UToastieCutsceneSubsystem::LoadScene(const TSoftObjectPtr<UToastieCutsceneAsset>& Scene, FOnToastieCutsceneSceneLoaded OnLoaded)
+{
+	LoadScene(Scene, [OnLoaded](UToastieCutsceneAsset* LoadedScene)
+	{
+		OnLoaded.ExecuteIfBound(LoadedScene);
+	});
+}
+
+void UToastieCutsceneSubsystem::LoadScene(const TSoftObjectPtr<UToastieCutsceneAsset>& Scene, TFunction<void(UToastieCutsceneAsset*)>&& OnLoaded)
+{
+	if (Scene.IsNull())
+	{
+		OnLoaded(nullptr);
+		return;
+	}
+
+	const auto ScenePath = Scene.ToSoftObjectPath();
+	auto& StreamedScene = FindOrStreamScene(ScenePath);
+	++StreamedScene.NumUsers;
+
+	// Scenes that were already loaded, or failed to start streaming, report straight away
+	if (!StreamedScene.Handle.IsValid() || StreamedScene.Handle->HasLoadCompleted())
+	{
+		OnLoaded(Cast<UToastieCutsceneAsset>(ScenePath.ResolveObject()));
+	}
+	else
+	{
+		StreamedScene.PendingCallbacks.Add(MoveTemp(OnLoaded));
+	}
+}
+
+void UToastieCutsceneSubsystem::ReleaseScene(const TSoftObjectPtr<UToastieCutsceneAsset>& Scene)
+{
+	if (auto StreamedScene = StreamedScenes.Find(Scene.ToSoftObjectPath());
+		StreamedScene && StreamedScene->NumUsers > 0)
+	{
+		if (--StreamedScene->NumUsers == 0)
+		{
+			StreamedScene->IdleSince = FPlatformTime::Seconds();
+		}
+	}
+}
+
+ACutscenePlayer* UToastieCutsceneSubsystem::PlayScene(UToastieCutsceneAsset* Scene, TSubclassOf<ACutscenePlayer> PlayerClass)
+{
+	if (!Scene)
+		return nullptr;
+
+	if (!PlayerClass)
+	{
+		PlayerClass = ACutscenePlayer::StaticClass();
+	}
+
+	// Reuse an idle player of the same class
+	ACutscenePlayer* CutscenePlayer = nullptr;
+	IdlePlayers.RemoveAll([](const ACutscenePlayer* IdlePlayer) { return !IsValid(IdlePlayer); });
+	for (int32 i = IdlePlayers.Num() - 1; i >= 0; --i)
+	{
+		if (IdlePlayers[i]->GetClass() == PlayerClass && !IdlePlayers[i]->IsPlaying())
+		{
+			CutscenePlayer = IdlePlayers[i];
+			IdlePlayers.RemoveAtSwap(i);
+			break;
+		}
+	}
+
+	if (!CutscenePlayer)
+	{
+		CutscenePlayer = GetWorld()->SpawnActorDeferred<ACutscenePlayer>(PlayerClass, FTransform::Identity);
+		if (!CutscenePlayer)
+			return nullptr;
+
+		CutscenePlayer->bDestroyOnFinish = false;
+		CutscenePlayer->OnCutsceneFinished.AddDynamic(this, &UToastieCutsceneSubsystem::OnPooledPlayerFinished);
+		CutscenePlayer->FinishSpawning(FTransform::Identity);
+	}
+
+	CutscenePlayer->Play(Scene);
+	return CutscenePlayer;
+}
+
+void UToastieCutsceneSubsystem::StopScene(ACutscenePlayer* CutscenePlayer)
+{
+	if (IsValid(CutscenePlayer) && !CutscenePlayer->bDestroyOnFinish)
+	{
+		CutscenePlayer->ResetForPool();
+		IdlePlayers.AddUnique(CutscenePlayer);
+	}
+}
+
+void UToastieCutsceneSubsystem::OnPooledPlayerFinished(ACutscenePlayer* CutscenePlayer)
+{
+	// A listener may have already played something else on it
+	if (IsValid(CutscenePlayer) && !CutscenePlayer->IsPlaying())
+	{
+		CutscenePlayer->ResetForPool();
+		IdlePlayers.AddUnique(CutscenePlayer);
+	}
+}
+
+int32 UToastieCutsceneSubsystem::StartRun(ACutscenePlayer& CutscenePlayer, const UToastieCutsceneAsset& Scene)
+{
+	// Reused runs keep the memory of their process pool
+	const auto RunHandle = FreeRuns.IsEmpty() ? Runs.Add(1) : FreeRuns.Pop(EAllowShrinking::No);
+
+	auto& Run = Runs[RunHandle];
+	Run.CutscenePlayer = &CutscenePlayer;
+	Run.LastTickTime = GetWorld()->GetTimeSeconds();
+	Run.WakeTime = 0.0;
+	Run.Serial = ++RunSerialCounter;
+	Run.bActive = true;
+	Run.ProcessPool.Start(Scene, CutscenePlayer);
+	return RunHandle;
+}
+
+void UToastieCutsceneSubsystem::StopRun(const int32 RunHandle)
+{
+	if (!IsValidRun(RunHandle))
+		return;
+
+	auto& Run = Runs[RunHandle];
+	Run.ProcessPool.Reset();
+	Run.CutscenePlayer.Reset();
+	Run.bActive = false;
+	FreeRuns.Add(RunHandle);
+}
+
+void UToastieCutsceneSubsystem::WakeRun(const int32 RunHandle)
+{
+	if (IsValidRun(RunHandle))
+	{
+		Runs[RunHandle].WakeTime = 0.0;
+	}
+}
+
+FCutsceneProcessPool* UToastieCutsceneSubsystem::GetRunProcessPool(const int32 RunHandle)
+{
+	return IsValidRun(RunHandle) ? &Runs[RunHandle].ProcessPool : nullptr;
+}
+
+bool UToastieCutsceneSubsystem::IsValidRun(const int32 RunHandle) const
+{
+	return RunHandle >= 0 && RunHandle < Runs.Num() && Runs[RunHandle].bActive;
+}
+
+bool UToastieCutsceneSubsystem::IsDueRunActive(const FDueRun& DueRun) const
+{
+	// Stopped or replaced by a command handler since it was gathered
+	const auto& Run = Runs[DueRun.RunHandle];
+	return Run.bActive && Run.Serial == DueRun.Serial;
+}
+
+void UToastieCutsceneSubsystem::TickRuns()
+{
+	TOASTIECUTSCENES_SCOPE(Tick);
+	const auto Now = GetWorld()->GetTimeSeconds();
+
+	// Gather the runs that are due. Runs started during the pass wait for the next frame
+	DueRuns.Reset();
+	const auto NumRuns = Runs.Num();
+	for (int32 RunHandle = 0; RunHandle < NumRuns; ++RunHandle)
+	{
+		auto& Run = Runs[RunHandle];
+		if (!Run.bActive || Run.WakeTime > Now)
+			continue;
+
+		const auto CutscenePlayer = Run.CutscenePlayer.Get();
+		if (!CutscenePlayer)
+		{
+			StopRun(RunHandle);
+			continue;
+		}
+
+		// Delays keep counting down while the run sleeps
+		auto& DueRun = DueRuns.AddDefaulted_GetRef();
+		DueRun.RunHandle = RunHandle;
+		DueRun.Serial = Run.Serial;
+		DueRun.CutscenePlayer = CutscenePlayer;
+		DueRun.ElapsedTime = static_cast<float>(Now - Run.LastTickTime);
+		Run.LastTickTime = Now;
+		Run.WakeTime = TNumericLimits<double>::Max();
+	}
+
+#if STATS
+	int32 NumActiveRuns = 0;
+	int32 NumProcesses = 0;
+	int32 NumCommands = 0;
+	for (int32 RunHandle = 0; RunHandle < NumRuns; ++RunHandle)
+	{
+		if (const auto& Run = Runs[RunHandle]; Run.bActive)
+		{
+			++NumActiveRuns;
+			NumProcesses += Run.ProcessPool.GetNumProcesses();
+			NumCommands += Run.ProcessPool.GetNumCommands();
+		}
+	}
+	SET_DWORD_STAT(STAT_ToastieCutscenes_ActivePlayers, NumActiveRuns);
+	SET_DWORD_STAT(STAT_ToastieCutscenes_ActiveProcesses, NumProcesses);
+	SET_DWORD_STAT(STAT_ToastieCutscenes_ActiveCommands, NumCommands);
+#endif
+
+	if (DueRuns.IsEmpty())
+		return;
+
+	// The serial tick runs the same phases on the game thread, so both give the same result
+	const auto ParallelForFlags = CVarToastieCutscenesParallelTick.GetValueOnGameThread()
+		? EParallelForFlags::None
+		: EParallelForFlags::ForceSingleThread;
+
+	// Each pool only touches its own records until its commands start
+	ParallelFor(DueRuns.Num(), [this](const int32 DueIndex)
+	{
+		const auto& DueRun = DueRuns[DueIndex];
+		Runs[DueRun.RunHandle].ProcessPool.Advance(DueRun.ElapsedTime);
+	}, ParallelForFlags);
+
+	for (const auto& DueRun : DueRuns)
+	{
+		if (IsDueRunActive(DueRun))
+		{
+			Runs[DueRun.RunHandle].ProcessPool.StartQueuedCommands(*DueRun.CutscenePlayer);
+		}
+	}
+
+	ParallelFor(DueRuns.Num(), [this](const int32 DueIndex)
+	{
+		auto& DueRun = DueRuns[DueIndex];
+		DueRun.bSettled = !IsDueRunActive(DueRun)
+			|| Runs[DueRun.RunHandle].ProcessPool.Settle(*DueRun.CutscenePlayer, false);
+	}, ParallelForFlags);
+
+	for (const auto& DueRun : DueRuns)
+	{
+		if (!IsDueRunActive(DueRun))
+			continue;
+
+		// Requirements that have to be checked on the game thread, in the same order as a serial tick
+		auto& Run = Runs[DueRun.RunHandle];
+		if (!DueRun.bSettled)
+		{
+			Run.ProcessPool.Settle(*DueRun.CutscenePlayer, true);
+			if (!IsDueRunActive(DueRun))
+				continue;
+		}
+
+		if (Run.ProcessPool.IsFinished())
+		{
+			DueRun.CutscenePlayer->FinishScene();
+			continue;
+		}
+
+		// Nothing changes until Blueprint finishes a command or the earliest delay runs out
+		auto WakeDelay = TNumericLimits<float>::Max();
+		if (!Run.ProcessPool.IsWaiting(WakeDelay))
+		{
+			Run.WakeTime = Now;
+		}
+		else if (WakeDelay < TNumericLimits<float>::Max())
+		{
+			Run.WakeTime = FMath::Min(Run.WakeTime, Now + WakeDelay);
+		}
+	}
+}
+
+void UToastieCutsceneSubsystem::Deinitialize()
+{
+	for (int32 RunHandle = 0; RunHandle < Runs.Num(); ++RunHandle)
+	{
+		StopRun(RunHandle);
+	}
+
+	for (auto& [ScenePath, StreamedScene] : StreamedScenes)
+	{
+		if (StreamedScene.Handle.IsValid())
+		{
+			StreamedScene.Handle->CancelHandle();
+		}
+	}
+	StreamedScenes.Empty();
+
+	Super::Deinitialize();
+}
+
+void UToastieCutsceneSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	TickRuns();
+
+	// Release Scenes nothing has used for a while, unless they're still loading
+	const auto Now = FPlatformTime::Seconds();
+	for (auto It = StreamedScenes.CreateIterator(); It; ++It)
+	{
+		const auto& StreamedScene = It.Value();
+		if (StreamedScene.NumUsers == 0
+			&& StreamedScene.PendingCallbacks.IsEmpty()
+			&& Now - StreamedScene.IdleSince >= SceneIdleReleaseTime)
+		{
+			if (StreamedScene.Handle.IsValid())
+			{
+				StreamedScene.Handle->ReleaseHandle();
+			}
+			It.RemoveCurrent();
+		}
+	}
+}
+
+TStatId UToastieCutsceneSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UToastieCutsceneSubsystem, STATGROUP_Tickables);
+}
+
+UToastieCutsceneSubsystem::FStreamedScene& UToastieCutsceneSubsystem::FindOrStreamScene(const FSoftObjectPath& ScenePath)
+{
+	if (auto Existing = StreamedScenes.Find(ScenePath))
+	{
+		return *Existing;
+	}
+
+	auto& StreamedScene = StreamedScenes.Add(ScenePath);
+	StreamedScene.IdleSince = FPlatformTime::Seconds();
+	StreamedScene.Handle = StreamableManager.RequestAsyncLoad(ScenePath,
+		FStreamableDelegate::CreateUObject(this, &UToastieCutsceneSubsystem::OnSceneStreamed, ScenePath));
+	return StreamedScene;
+}
+
+void UToastieCutsceneSubsystem::OnSceneStreamed(FSoftObjectPath ScenePath)
+{
+	auto StreamedScene = StreamedScenes.Find(ScenePath);
+	if (!StreamedScene)
+		return;
+
+	const auto LoadedScene = Cast<UToastieCutsceneAsset>(ScenePath.ResolveObject());
+	if (!LoadedScene)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("TCS: Unable to load Scene %s"), *ScenePath.ToString());
+	}
+
+	// Callbacks may load or release other Scenes, which can move StreamedScene
+	auto Callbacks = MoveTemp(StreamedScene->PendingCallbacks);
+	for (auto& Callback : Callbacks)
+	{
+		Callback(LoadedScene);
+	}
+}
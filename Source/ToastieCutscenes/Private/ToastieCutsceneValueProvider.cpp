@@ -0,0 +1,54 @@
+#include "ToastieCutsceneValueProvider.h"
+
+void IToastieCutsceneValueProvider::GetCutsceneValues(TConstArrayView<FName> Keys, TArrayView<int32> OutValues) const
+{
+	check(Keys.Num() == OutValues.Num());
+	for (int32 i = 0; i < Keys.Num(); ++i)
+	{
+		OutValues[i] = GetCutsceneValue(Keys[i]);
+	}
+}
+
+bool IToastieCutsceneValueProvider::AreRequirementsMet(const IToastieCutsceneValueProvider* Provider, const TArray<FToastieCutsceneReq>& Reqs)
+{
+	for (const auto& Req : Reqs)
+	{
+		const auto CurrentValue = Provider ? Provider->GetCutsceneValue(Req.Key) : 0;
+		if (!Req.IsMet(CurrentValue))
+			return false;
+	}
+	return true;
+}
+
+void IToastieCutsceneValueProvider::AreRequirementsMet(const IToastieCutsceneValueProvider* Provider,
+	TConstArrayView<const TArray<FToastieCutsceneReq>*> RequirementLists, TArrayView<bool> OutMet)
+{
+	check(RequirementLists.Num() == OutMet.Num());
+
+	// Gather the keys of every list so the provider is asked once
+	TArray<FName, TInlineAllocator<16>> Keys;
+	for (const auto Reqs : RequirementLists)
+	{
+		for (const auto& Req : *Reqs)
+		{
+			Keys.Add(Req.Key);
+		}
+	}
+
+	TArray<int32, TInlineAllocator<16>> Values;
+	Values.SetNumZeroed(Keys.Num());
+	if (Provider && !Keys.IsEmpty())
+	{
+		Provider->GetCutsceneValues(Keys, Values);
+	}
+
+	int32 ValueIndex = 0;
+	for (int32 i = 0; i < RequirementLists.Num(); ++i)
+	{
+		OutMet[i] = true;
+		for (const auto& Req : *RequirementLists[i])
+		{
+			OutMet[i] &= Req.IsMet(Values[ValueIndex++]);
+		}
+	}
+}
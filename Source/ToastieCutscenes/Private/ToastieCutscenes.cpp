@@ -1,16 +1,30 @@
 #include "ToastieCutscenes.h"
+#include "ToastieCutscenesStats.h"
+#include "CutsceneCommandHandler.h"
+
+DEFINE_STAT(STAT_ToastieCutscenes_Tick);
+DEFINE_STAT(STAT_ToastieCutscenes_FetchCommands);
+DEFINE_STAT(STAT_ToastieCutscenes_ExecuteCommand);
+DEFINE_STAT(STAT_ToastieCutscenes_Requirements);
+DEFINE_STAT(STAT_ToastieCutscenes_FindLabel);
+DEFINE_STAT(STAT_ToastieCutscenes_ActivePlayers);
+DEFINE_STAT(STAT_ToastieCutscenes_ActiveProcesses);
+DEFINE_STAT(STAT_ToastieCutscenes_ActiveCommands);
+DEFINE_STAT(STAT_ToastieCutscenes_QueuedCommands);
 
 #define LOCTEXT_NAMESPACE "FToastieCutscenesModule"
 
 void FToastieCutscenesModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+	FCutsceneCommandHandlers::RegisterBuiltInHandlers();
 }
 
 void FToastieCutscenesModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	FCutsceneCommandHandlers::UnregisterAll();
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CutscenePlayer.h"
+
+/**
+ * Runs one type of command natively, in place of the CutscenePlayer's Blueprint event for it.
+ * Handlers are shared by every player, so any state of a running command belongs on the player
+ */
+class TOASTIECUTSCENES_API ICutsceneCommandHandler
+{
+public:
+	virtual ~ICutsceneCommandHandler() = default;
+
+	/** Runs Command. If it returns InProgress, the command runs until CutscenePlayer.FinishCommand(Id) is called */
+	virtual ECutscenePlayerExecuteResult Execute(ACutscenePlayer& CutscenePlayer, const int32 Id, const FInstancedStruct& Command) = 0;
+};
+
+/** Handler for commands of type T, T must be the struct the handler is registered with */
+template<typename T>
+class TCutsceneCommandHandler : public ICutsceneCommandHandler
+{
+public:
+	virtual ECutscenePlayerExecuteResult Execute(ACutscenePlayer& CutscenePlayer, const int32 Id, const T& Command) = 0;
+
+	virtual ECutscenePlayerExecuteResult Execute(ACutscenePlayer& CutscenePlayer, const int32 Id, const FInstancedStruct& Command) override
+	{
+		return Execute(CutscenePlayer, Id, Command.Get<T>());
+	}
+};
+
+/**
+ * Native command handlers, keyed by the struct of the command they run. CutscenePlayers run a command with its handler
+ * unless their class implements the command's Execute event, commands without a handler go to Blueprint.
+ * Flow commands (PlayerChoice, Goto, Exit) are always run by the player.
+ * Game thread only
+ */
+class TOASTIECUTSCENES_API FCutsceneCommandHandlers
+{
+public:
+	/** Runs every command of CommandStruct with Handler, replacing the handler registered before it */
+	static void Register(const UScriptStruct& CommandStruct, TSharedRef<ICutsceneCommandHandler> Handler);
+
+	template<typename T>
+	static void Register(TSharedRef<ICutsceneCommandHandler> Handler)
+	{
+		Register(*T::StaticStruct(), MoveTemp(Handler));
+	}
+
+	static void Unregister(const UScriptStruct& CommandStruct);
+
+	template<typename T>
+	static void Unregister()
+	{
+		Unregister(*T::StaticStruct());
+	}
+
+	/** The handler registered for CommandStruct, nullptr if its commands go to Blueprint */
+	static ICutsceneCommandHandler* Find(const UScriptStruct* CommandStruct);
+
+	/** Registers the handlers that ship with the plugin, called on module startup */
+	static void RegisterBuiltInHandlers();
+
+	static void UnregisterAll();
+
+private:
+	static TMap<const UScriptStruct*, TSharedRef<ICutsceneCommandHandler>> Handlers;
+};
+
+/** Finishes a Wait after its Time with a world timer, so it follows pausing and time dilation */
+class TOASTIECUTSCENES_API FCutsceneWaitHandler : public TCutsceneCommandHandler<FToastieCutsceneWait>
+{
+public:
+	using TCutsceneCommandHandler::Execute;
+	virtual ECutscenePlayerExecuteResult Execute(ACutscenePlayer& CutscenePlayer, const int32 Id, const FToastieCutsceneWait& Command) override;
+};
+
+/** Gives back the input the CutscenePlayer took with DisablePlayerControl */
+class TOASTIECUTSCENES_API FCutsceneEnablePlayerControlHandler : public TCutsceneCommandHandler<FToastieCutsceneEnablePlayerControl>
+{
+public:
+	using TCutsceneCommandHandler::Execute;
+	virtual ECutscenePlayerExecuteResult Execute(ACutscenePlayer& CutscenePlayer, const int32 Id, const FToastieCutsceneEnablePlayerControl& Command) override;
+};
+
+/** Ignores movement and look input of the first local player until EnablePlayerControl or the Scene stops */
+class TOASTIECUTSCENES_API FCutsceneDisablePlayerControlHandler : public TCutsceneCommandHandler<FToastieCutsceneDisablePlayerControl>
+{
+public:
+	using TCutsceneCommandHandler::Execute;
+	virtual ECutscenePlayerExecuteResult Execute(ACutscenePlayer& CutscenePlayer, const int32 Id, const FToastieCutsceneDisablePlayerControl& Command) override;
+};
@@ -3,6 +3,8 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "ToastieCutsceneAsset.h"
+#include "CutsceneProcessPool.h"
+#include "ToastieCutsceneValueProvider.h"
 #include "CutscenePlayer.generated.h"
 
 UENUM(BlueprintType)
@@ -12,8 +14,20 @@ enum class ECutscenePlayerExecuteResult : uint8
 	InProgress		UMETA(DisplayName = "In Progress")
 };
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnCutsceneFinished, ACutscenePlayer*, CutscenePlayer);
+
+class UToastieCutsceneSubsystem;
+class APlayerController;
+
+/**
+ * Plays a Scene by handing its commands to their native handler in FCutsceneCommandHandlers, or to Blueprint
+ * for commands without one. A Blueprint subclass that implements a command's Execute event runs it instead of
+ * the handler. The Scene's processes are owned and ticked in one batch by UToastieCutsceneSubsystem, the player
+ * only keeps a handle to them.
+ * The actor tick starts off, it's turned on at BeginPlay for Blueprint subclasses that implement Event Tick
+ */
 UCLASS()
-class TOASTIECUTSCENES_API ACutscenePlayer : public AActor
+class TOASTIECUTSCENES_API ACutscenePlayer : public AActor, public ICutsceneCommandExecutor
 {
 	GENERATED_BODY()
 	
@@ -21,10 +35,46 @@ public:
 	// Sets default values for this actor's properties
 	ACutscenePlayer();
 
+	/** Stops whatever is playing and plays InScene from the start */
+	UFUNCTION(BlueprintCallable)
+	void Play(UToastieCutsceneAsset* InScene);
+
+	/** Stops playing without finishing, OnCutsceneFinished isn't broadcast */
+	UFUNCTION(BlueprintCallable)
+	void Stop();
+
+	/** Stops playing and forgets the Scene, leaving the player ready for reuse by the subsystem's pool */
+	void ResetForPool();
+
+	UFUNCTION(BlueprintPure)
+	bool IsPlaying() const { return bPlaying; }
+
+	/** Finishes the command with Id, for commands whose Execute returned In Progress */
+	UFUNCTION(BlueprintCallable)
+	void FinishCommand(const int32 Id);
+
+	/** Finishes the command with Id after Time seconds of world time, unless the player is stopped first */
+	void FinishCommandAfter(const int32 Id, const float Time);
+
+	/** Ignores movement and look input of the first local player, until EnablePlayerControl or the player stops */
+	void DisablePlayerControl();
+
+	/** Gives back the input taken by DisablePlayerControl. Does nothing if this player didn't take it */
+	void EnablePlayerControl();
+
+	/** Broadcast when the Scene has played to the end */
+	UPROPERTY(BlueprintAssignable)
+	FOnCutsceneFinished OnCutsceneFinished;
+
+	/** Destroy this actor once its Scene has finished, turn off to reuse the player */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta=(ExposeOnSpawn))
+	bool bDestroyOnFinish;
+
 protected:
 	
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	
 	UFUNCTION(BlueprintImplementableEvent)
 	bool RequirementsAreMet(const TArray<FToastieCutsceneReq>& Reqs) const;
@@ -44,95 +94,102 @@ protected:
 	UFUNCTION(BlueprintImplementableEvent)
 	ECutscenePlayerExecuteResult ExecuteLookAt(const int32 Id, const FToastieCutsceneLookAt& Data);
 
+	/** Options are read with GetChoiceOptionText, only the ones visible in Choice should be shown */
 	UFUNCTION(BlueprintImplementableEvent)
-	ECutscenePlayerExecuteResult ExecutePlayerChoice(const int32 Id, const TArray<FToastieCutsceneOption>& Data);
+	ECutscenePlayerExecuteResult ExecutePlayerChoice(const int32 Id, const FToastieCutsceneChoice& Choice);
 
+	/** Finishes the PlayerChoice with Id, continuing from the Option at OptionIndex. Options that weren't visible are rejected */
 	UFUNCTION(BlueprintCallable)
-	void FinishCommand(const int32 Id);
+	void FinishPlayerChoice(const int32 Id, const int32 OptionIndex);
 
-	UFUNCTION(BlueprintCallable)
-	void FinishPlayerChoice(const int32 Id, const FToastieCutsceneOption& Option);
+	/** Text of the Option at OptionIndex of Choice, read from the Scene */
+	UFUNCTION(BlueprintPure)
+	FText GetChoiceOptionText(const FToastieCutsceneChoice& Choice, const int32 OptionIndex) const;
+
+	/** Label of the Option at OptionIndex of Choice, Exit for an Option that ends the cutscene */
+	UFUNCTION(BlueprintPure)
+	FName GetChoiceOptionLabel(const FToastieCutsceneChoice& Choice, const int32 OptionIndex) const;
+
+	UFUNCTION(BlueprintPure)
+	static bool IsChoiceOptionVisible(const FToastieCutsceneChoice& Choice, const int32 OptionIndex) { return Choice.IsOptionVisible(OptionIndex); }
 	
 	UPROPERTY(BlueprintReadOnly, meta=(ExposeOnSpawn))
 	UToastieCutsceneAsset* Scene;
 
-public:	
-	// Called every frame
-	virtual void Tick(const float DeltaTime) override;
-	
+	/** Played once it has streamed in, when Scene isn't set */
+	UPROPERTY(BlueprintReadOnly, meta=(ExposeOnSpawn))
+	TSoftObjectPtr<UToastieCutsceneAsset> SoftScene;
+
+	/** Scenes the game plays after an Option, keyed by the Option's Label */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta=(ExposeOnSpawn))
+	TMap<FName, TSoftObjectPtr<UToastieCutsceneAsset>> BranchScenes;
+
+	/** Start loading the BranchScenes of every Option when a PlayerChoice is presented */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bPrefetchBranches;
+
+	/** Game values that Requirements are checked against natively. Without one, the RequirementsAreMet event is used */
+	UPROPERTY(BlueprintReadWrite, meta=(ExposeOnSpawn))
+	TScriptInterface<IToastieCutsceneValueProvider> ValueProvider;
+
+	/** Check Requirements with the RequirementsAreMet event instead of ValueProvider */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bUseBlueprintRequirements;
+
 private:
 
-	int32 FindLabel(const FString& Label) const;
-	
-	template<typename T>
-	bool TryExecuteCommand(
-		const int32 Id,
-		const FInstancedStruct& Data,
-		ECutscenePlayerExecuteResult (ACutscenePlayer::*Function)(const int32, const T&),
-		ECutscenePlayerExecuteResult& Result)
-	{
-		const T* Ptr = Data.GetPtr<T>();
-		if (Ptr)
-		{
-			Result = (this->*Function)(Id, *Ptr);
-			return true;
-		}
-		return false;
-	}
+	friend class UToastieCutsceneSubsystem;
+
+	void StartScene();
+	void OnSceneLoaded(UToastieCutsceneAsset* LoadedScene);
+	void FinishScene();
+	void ReleaseSoftScene();
 
+	UToastieCutsceneSubsystem* GetCutsceneSubsystem() const;
+	FCutsceneProcessPool* GetProcessPool() const;
+
+	const FToastieCutsceneOption* GetChoiceOption(const FToastieCutsceneChoice& Choice, const int32 OptionIndex) const;
+	bool JumpToTarget(const int32 Id, const int32 Target);
+	
 	ECutscenePlayerExecuteResult ExecuteCommand(const int32 Index, const int32 Id);
 
-	class FAProcess
+	// Whether a Blueprint subclass implements the Execute event for commands of Opcode, which then replaces their handler
+	bool ImplementsExecuteEvent(const EToastieCutsceneOpcode Opcode) const;
+
+	// Whether Requirements go to the RequirementsAreMet event rather than ValueProvider
+	bool UsesBlueprintRequirements() const;
+	void WarnMissingValueProvider();
+
+	// Checks the Requirements of each list in one go, for the Options of a PlayerChoice
+	void EvaluateRequirements(TConstArrayView<const TArray<FToastieCutsceneReq>*> RequirementLists, TArrayView<bool> OutMet);
+
+	// ICutsceneCommandExecutor
+	virtual bool CheckRequirements(const TArray<FToastieCutsceneReq>& Reqs) override;
+	virtual bool CanCheckRequirementsOnAnyThread() const override;
+	virtual bool StartCommand(const int32 Index, const int32 Id) override;
+
+	// Handle to the processes of the playing Scene in UToastieCutsceneSubsystem
+	int32 RunHandle;
+
+	// Whether SoftScene was requested from the subsystem and must be released
+	bool bLoadedSoftScene;
+	bool bWaitingForSoftScene;
+	bool bPlaying;
+	bool bWarnedMissingValueProvider;
+
+	// Bumped by Stop, so a timer from FinishCommandAfter can tell its command belongs to an older run
+	uint32 PlaySerial;
+
+	// A PlayerChoice handed to Blueprint and waiting on FinishPlayerChoice
+	struct FPresentedChoice
 	{
-	public:
-		bool IsFinishedCurrentActions() const;
-		bool IsFinished(const ACutscenePlayer& CutscenePlayer) const;
-		
-		void FetchCommands(ACutscenePlayer& CutscenePlayer);
-		void Tick(const float DeltaTime, ACutscenePlayer& CutscenePlayer);
-
-		enum class ECommandStates : uint8
-		{
-			Delayed,
-			Queued,
-			Running,
-			Finished
-		};
-	
-		struct FCommandState
-		{
-			int32 Id;
-			int32 Index;
-			float DelayedTimeRemaining;
-			ECommandStates State;
-			bool bBlocking;
-		};
-
-		TArray<FAProcess> Children;
-		TArray<FCommandState> ActiveCommands;
-		int32 EndIndex = 0;
-		int32 CurrentIndex = 0;
-		float Delay = 0.0f;
-		bool bConcurrent = false;
-		bool bBlocking = true;
+		int32 Id = 0;
+		FToastieCutsceneChoice Choice;
 	};
 
-	FAProcess Process;
-	int32 IdCounter;
+	// Kept so FinishPlayerChoice only accepts Options that were shown
+	TArray<FPresentedChoice, TInlineAllocator<2>> PresentedChoices;
 
-	template<typename F>
-	void ForEachProcessImpl(F Functor, FAProcess& CurrentProcess)
-	{
-		Functor(CurrentProcess);
-		for (auto& ChildProcess : Process.Children)
-		{
-			ForEachProcessImpl(Functor, ChildProcess);
-		}
-	}
-
-	template<typename F>
-	void ForEachProcess(F Functor)
-	{
-		ForEachProcessImpl(Functor, Process);
-	}
+	// Controller whose input DisablePlayerControl took, so only that is given back
+	TWeakObjectPtr<APlayerController> DisabledPlayerController;
 };
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ToastieCutsceneAsset.h"
+
+/** Checks requirements and runs commands on behalf of a FCutsceneProcessPool */
+class TOASTIECUTSCENES_API ICutsceneCommandExecutor
+{
+public:
+	virtual ~ICutsceneCommandExecutor() = default;
+
+	/** Whether a command with these requirements should be run */
+	virtual bool CheckRequirements(const TArray<FToastieCutsceneReq>& Reqs) = 0;
+
+	/** Whether CheckRequirements may be called from a worker thread while the pool settles */
+	virtual bool CanCheckRequirementsOnAnyThread() const { return false; }
+
+	/**
+	 * Starts the command at Index of the scene. Returns true if it finished immediately.
+	 * A command finished through FinishCommand before this returns stays finished, whatever is returned
+	 */
+	virtual bool StartCommand(const int32 Index, const int32 Id) = 0;
+};
+
+/**
+ * Schedules the commands of a scene. Every Block becomes a process that fetches and ticks its own commands.
+ * Processes and active commands are records in flat arrays, linked by index and recycled through free lists,
+ * so once the arrays have grown to fit a scene, playing it doesn't allocate.
+ *
+ * A tick runs in three phases. Advance and Settle only touch the pool, so the pools of different scenes can
+ * run them on worker threads, while StartQueuedCommands calls into the executor on the game thread.
+ * Tick runs the same phases back to back, so a serial tick gives the same result as a parallel one.
+ * A process whose last blocking child finishes during the tick runs its own commands in the same tick,
+ * so Settle starts those once it is back on the game thread.
+ */
+class TOASTIECUTSCENES_API FCutsceneProcessPool
+{
+public:
+	/** Resets the pool and fetches the first commands of Scene. The caller keeps Scene alive */
+	void Start(const UToastieCutsceneAsset& InScene, ICutsceneCommandExecutor& Executor);
+
+	/** Drops every process and command at once, keeping the memory for the next scene. Safe to call from the executor */
+	void Reset();
+
+	/** Runs all three phases of a tick on the calling thread */
+	void Tick(const float DeltaTime, ICutsceneCommandExecutor& Executor);
+
+	/** Counts down delays and queues the commands that are ready to start. Doesn't call the executor */
+	void Advance(const float DeltaTime);
+
+	/** Starts the commands queued by Advance, in the order they were queued. Game thread only */
+	void StartQueuedCommands(ICutsceneCommandExecutor& Executor);
+
+	/**
+	 * Clears finished commands and processes, and fetches the next commands. Also starts the commands of processes
+	 * whose blocking children finished this tick. Off the game thread, no commands are started and only requirements
+	 * the executor can check on any thread are checked. Returns false if settling stopped at either,
+	 * Settle must then be called again on the game thread to finish the tick
+	 */
+	bool Settle(ICutsceneCommandExecutor& Executor, const bool bOnGameThread);
+
+	bool IsFinished() const;
+
+	/**
+	 * True if nothing can happen until a running command is finished or a delay runs out.
+	 * WakeDelay is lowered to the earliest delay still counting down
+	 */
+	bool IsWaiting(float& WakeDelay) const;
+
+	/** Marks the command with Id as finished, it's removed on the next tick */
+	void FinishCommand(const int32 Id);
+
+	/** Index in the Scene of the command with Id, INDEX_NONE if Id isn't active */
+	int32 GetCommandIndex(const int32 Id) const;
+
+	/** Continues the process that ran the command with Id from Index. Returns false if Id isn't active */
+	bool ContinueFrom(const int32 Id, const int32 Index);
+
+	/** Stops every process from fetching more commands */
+	void StopFetching();
+
+	int32 GetNumProcesses() const { return NumProcesses; }
+	int32 GetNumCommands() const { return NumCommands; }
+
+	/** Memory held by the records, including the slack kept for the next scene */
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	enum class ECommandState : uint8
+	{
+		Delayed,
+		Queued,
+		Running,
+		Finished
+	};
+
+	struct FCommandRecord
+	{
+		int32 Id = 0;
+		int32 Index = 0;
+		int32 Process = INDEX_NONE;
+		int32 Next = INDEX_NONE;
+		float DelayedTimeRemaining = 0.0f;
+		ECommandState State = ECommandState::Queued;
+		bool bBlocking = true;
+	};
+
+	// What is left to do for a process that stopped settling to continue on the game thread
+	enum class ESettleResume : uint8
+	{
+		None,
+		Children,
+		StartCommands,
+		Fetch
+	};
+
+	struct FQueuedCommand
+	{
+		int32 CommandIndex = INDEX_NONE;
+		int32 Id = 0;
+	};
+
+	struct FProcessRecord
+	{
+		int32 FirstChild = INDEX_NONE;
+		int32 LastChild = INDEX_NONE;
+		int32 NextSibling = INDEX_NONE;
+		int32 FirstCommand = INDEX_NONE;
+		int32 LastCommand = INDEX_NONE;
+		int32 EndIndex = 0;
+		int32 CurrentIndex = 0;
+		float Delay = 0.0f;
+		uint32 SettledTick = 0;
+		uint32 AdvancedTick = 0;
+		ESettleResume Resume = ESettleResume::None;
+		bool bConcurrent = false;
+		bool bBlocking = true;
+	};
+
+	static constexpr int32 RootProcess = 0;
+
+	int32 AllocateProcess();
+	void ReleaseProcess(const int32 ProcessIndex);
+	int32 AllocateCommand();
+	void ReleaseCommand(const int32 CommandIndex);
+
+	void AdvanceProcess(const int32 ProcessIndex, const float DeltaTime);
+	bool AdvanceCommands(const int32 ProcessIndex, const float DeltaTime, const bool bQueue);
+	bool StartProcessCommands(const int32 ProcessIndex, ICutsceneCommandExecutor& Executor);
+	bool SettleProcess(const int32 ProcessIndex, ICutsceneCommandExecutor& Executor, const bool bOnGameThread);
+	bool FetchCommands(const int32 ProcessIndex, ICutsceneCommandExecutor& Executor, const bool bOnGameThread);
+	void RemoveFinishedCommands(const int32 ProcessIndex);
+	bool IsFinishedCurrentActions(const int32 ProcessIndex) const;
+	bool IsProcessFinished(const int32 ProcessIndex) const;
+	bool IsProcessWaiting(const int32 ProcessIndex, float& WakeDelay) const;
+
+	const UToastieCutsceneAsset* Scene = nullptr;
+	TArray<FProcessRecord> Processes;
+	TArray<FCommandRecord> Commands;
+	int32 FreeProcesses = INDEX_NONE;
+	int32 FreeCommands = INDEX_NONE;
+	int32 NumProcesses = 0;
+	int32 NumCommands = 0;
+
+	// Id of each active command to its record
+	TMap<int32, int32> CommandsById;
+	int32 IdCounter = 0;
+
+	// Commands queued by Advance, in the order they're started
+	TArray<FQueuedCommand> QueuedCommands;
+
+	// Bumped by Advance, a process settled during the current tick is skipped when settling resumes
+	uint32 TickSerial = 0;
+
+	// DeltaTime of the current tick, for commands that only start ticking once their process settles
+	float TickDeltaTime = 0.0f;
+
+	// Bumped by Reset, so a tick that called into the executor can tell its records are gone
+	uint32 Generation = 0;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CutsceneProcessPool.h"
+
+class IToastieCutsceneValueProvider;
+
+/** Virtual durations and choice policy of a FCutsceneSimulator */
+struct TOASTIECUTSCENES_API FCutsceneSimulationSettings
+{
+	/** Virtual seconds between ticks */
+	float TickInterval = 1.0f / 60.0f;
+
+	/** The simulation gives up after this many virtual seconds, Scenes that loop may never finish */
+	float MaxTime = 3600.0f;
+
+	/** Seconds a Say stays up when it isn't Timed */
+	float SayDuration = 2.0f;
+	float LookAtDuration = 0.5f;
+	float PlayerChoiceDuration = 1.0f;
+	float CustomDuration = 0.0f;
+
+	/** Seeds the choice policy, the same seed picks the same Options */
+	int32 Seed = 0;
+
+	/** Values requirements are checked against. A null provider reads every value as 0 */
+	const IToastieCutsceneValueProvider* ValueProvider = nullptr;
+
+	/** Keep the index of every started command in the result */
+	bool bRecordCommands = false;
+};
+
+struct TOASTIECUTSCENES_API FCutsceneSimulationResult
+{
+	bool bFinished = false;
+	int32 NumTicks = 0;
+	int32 NumCommands = 0;
+	int32 NumChoices = 0;
+	float SimulatedTime = 0.0f;
+
+	/** Largest memory held by the simulation's processes and commands while it ran */
+	SIZE_T PeakAllocatedSize = 0;
+
+	/** Index in Commands of every command started, in order, if bRecordCommands was set */
+	TArray<int32> StartedCommands;
+};
+
+/**
+ * Plays a Scene without a world or Blueprint, through the same FCutsceneProcessPool a CutscenePlayer uses.
+ * Commands finish by themselves after virtual durations, and each PlayerChoice picks one of its visible Options
+ * from a seeded random stream, so a run is repeatable for a given seed
+ */
+class TOASTIECUTSCENES_API FCutsceneSimulator : public ICutsceneCommandExecutor
+{
+public:
+	explicit FCutsceneSimulator(const FCutsceneSimulationSettings& InSettings);
+
+	/** Plays Scene until it finishes or MaxTime has passed */
+	FCutsceneSimulationResult Run(const UToastieCutsceneAsset& InScene);
+
+	/** Memory held by the process pool and running commands */
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	struct FRunningCommand
+	{
+		int32 Id = 0;
+		float TimeRemaining = 0.0f;
+
+		// Target of the Option a PlayerChoice picked, it continues from there once it finishes
+		int32 ChosenTarget = INDEX_NONE;
+		bool bChoice = false;
+	};
+
+	// ICutsceneCommandExecutor
+	virtual bool CheckRequirements(const TArray<FToastieCutsceneReq>& Reqs) override;
+	virtual bool CanCheckRequirementsOnAnyThread() const override;
+	virtual bool StartCommand(const int32 Index, const int32 Id) override;
+
+	void TickRunningCommands(const float DeltaTime);
+	bool StartPlayerChoice(const int32 Index, const int32 Id);
+	void JumpToTarget(const int32 Id, const int32 Target);
+
+	FCutsceneSimulationSettings Settings;
+	FCutsceneProcessPool ProcessPool;
+	TArray<FRunningCommand> RunningCommands;
+	FRandomStream ChoiceStream;
+
+	const UToastieCutsceneAsset* Scene = nullptr;
+	FCutsceneSimulationResult* Result = nullptr;
+};
@@ -44,6 +44,25 @@ enum class EToastieCutsceneBlockType : uint8
 	PlayerChoice		UMETA(DisplayName = "Player Choice")
 };
 
+/** What the CutscenePlayer does with a command, resolved from the command's struct type on import */
+UENUM()
+enum class EToastieCutsceneOpcode : uint8
+{
+	Invalid,				// Not a command, skipped
+	Custom,					// A command with no built in behaviour
+	Block,					// Sequential or Concurrent Block
+	PlayerChoice,
+	Say,
+	EnablePlayerControl,
+	DisablePlayerControl,
+	Wait,
+	LookAt,
+	Exit,
+	Goto,
+	Label,
+	Option
+};
+
 USTRUCT()
 struct TOASTIECUTSCENES_API FToastieCutsceneDataBase
 {
@@ -65,9 +84,12 @@ struct TOASTIECUTSCENES_API FToastieCutsceneReq : public FToastieCutsceneDataBas
 {
 	GENERATED_BODY()
 
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "1")) FString Key;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "1")) FName Key;
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "2")) EToastieCutsceneOperator Op;
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "3")) int32 Value;
+
+	/** Compares the game's current value for Key against Value using Op */
+	bool IsMet(const int32 CurrentValue) const;
 };
 
 USTRUCT(BlueprintType)
@@ -96,7 +118,7 @@ struct TOASTIECUTSCENES_API FToastieCutsceneSay : public FToastieCutsceneCommand
 {
 	GENERATED_BODY()
 
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "0")) FString Who;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "0")) FName Who;
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "1")) FText Line;
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Property = "Timed")) double Time;
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Property = "NoAnimation")) bool bNoAnimation;
@@ -133,8 +155,8 @@ struct TOASTIECUTSCENES_API FToastieCutsceneLookAt : public FToastieCutsceneComm
 {
 	GENERATED_BODY()
 
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "1")) FString Who;
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "2")) FString Target;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "1")) FName Who;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "2")) FName Target;
 };
 
 /// <summary> Exit </summary>
@@ -150,7 +172,7 @@ struct TOASTIECUTSCENES_API FToastieCutsceneGoto : public FToastieCutsceneComman
 {
 	GENERATED_BODY()
 
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "1")) FString Label;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "1")) FName Label;
 };
 
 /// <summary> Label </summary>
@@ -159,7 +181,7 @@ struct TOASTIECUTSCENES_API FToastieCutsceneLabel : public FToastieCutsceneComma
 {
 	GENERATED_BODY()
 
-	UPROPERTY(EditAnywhere, BlueprintReadOnly) FString Label;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly) FName Label;
 };
 
 /// <summary> Option </summary>
@@ -168,8 +190,56 @@ struct TOASTIECUTSCENES_API FToastieCutsceneOption : public FToastieCutsceneComm
 {
 	GENERATED_BODY()
 
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "1")) FString Label;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "1")) FName Label;
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (Index = "2")) FText DisplayText;
+
+	/** Label of an Option that ends the cutscene instead of jumping */
+	static const FName ExitLabel;
+};
+
+/** A PlayerChoice being presented. Its Options are read from the Scene by index, nothing is copied */
+USTRUCT(BlueprintType)
+struct TOASTIECUTSCENES_API FToastieCutsceneChoice
+{
+	GENERATED_BODY()
+
+	/** Index of the PlayerChoice in the Scene's Commands */
+	UPROPERTY(BlueprintReadOnly) int32 CommandIndex = INDEX_NONE;
+
+	/** Every Option of the PlayerChoice, visible or not */
+	UPROPERTY(BlueprintReadOnly) int32 NumOptions = 0;
+
+	/** Bit N is set if Option N met its Requirements */
+	UPROPERTY(BlueprintReadOnly) int64 VisibleMask = 0;
+
+	static constexpr int32 MaxOptions = 64;
+
+	bool IsOptionVisible(const int32 OptionIndex) const
+	{
+		return OptionIndex >= 0 && OptionIndex < NumOptions && (VisibleMask & (int64(1) << OptionIndex)) != 0;
+	}
+};
+
+/** Where playback goes from a command, compiled from Commands so nesting and Labels aren't worked out while playing */
+USTRUCT()
+struct TOASTIECUTSCENES_API FToastieCutsceneFlowNode
+{
+	GENERATED_BODY()
+
+	/** Index of the next command at the same depth, past everything a Block or PlayerChoice contains */
+	UPROPERTY() int32 Next = 0;
+
+	/** Index of the last command a Block or PlayerChoice contains, the command's own index otherwise */
+	UPROPERTY() int32 Last = 0;
+
+	/** Goto and Option: index playback continues from. ExitTarget for an Option that ends the cutscene, INDEX_NONE if its Label doesn't exist */
+	UPROPERTY() int32 Target = INDEX_NONE;
+
+	/** PlayerChoice: range of its Options in UToastieCutsceneAsset::ChoiceOptions */
+	UPROPERTY() int32 FirstOption = 0;
+	UPROPERTY() int32 NumOptions = 0;
+
+	static constexpr int32 ExitTarget = -2;
 };
 
 /**
@@ -188,11 +258,89 @@ public:
 	UPROPERTY(BlueprintReadOnly)
 	bool bDialogue;
 
+	/** Opcode of each entry in Commands */
+	UPROPERTY()
+	TArray<EToastieCutsceneOpcode> Opcodes;
+
+	/** Index in Commands of every Label, keyed by the Label's name */
+	UPROPERTY()
+	TMap<FName, int32> LabelIndices;
+
+	/** Control flow of each entry in Commands */
+	UPROPERTY()
+	TArray<FToastieCutsceneFlowNode> Flow;
+
+	/** Index in Commands of the Options of every PlayerChoice, grouped by PlayerChoice */
+	UPROPERTY()
+	TArray<int32> ChoiceOptions;
+
+	/** Version of the data derived from Commands, assets older than CurrentRuntimeDataVersion are rebuilt on load */
+	UPROPERTY()
+	int32 RuntimeDataVersion = 0;
+
+	static constexpr int32 CurrentRuntimeDataVersion = 3;
+
 #if WITH_EDITORONLY_DATA
 	UPROPERTY(VisibleAnywhere, Instanced, Category = ImportSettings)
 	TObjectPtr<UAssetImportData> AssetImportData;
+
+	/** Hash of this Scene's source when it was imported, reimports leave the asset alone while it matches */
+	UPROPERTY()
+	uint64 SourceHash = 0;
 #endif
 
+	/** Rebuilds everything derived from Commands, the importer calls this after filling Commands */
+	void BuildRuntimeData();
+
+	EToastieCutsceneOpcode GetOpcode(const int32 Index) const
+	{
+		return Opcodes.IsValidIndex(Index) ? Opcodes[Index] : EToastieCutsceneOpcode::Invalid;
+	}
+
+	/** Unchecked access to the control flow of a command */
+	const FToastieCutsceneFlowNode& GetFlow(const int32 Index) const
+	{
+		return Flow[Index];
+	}
+
+	/** Index in Commands of each Option of the PlayerChoice at Index */
+	TConstArrayView<int32> GetChoiceOptions(const int32 Index) const
+	{
+		const auto& Node = Flow[Index];
+		return TConstArrayView<int32>(ChoiceOptions.GetData() + Node.FirstOption, Node.NumOptions);
+	}
+
+	/** Unchecked access to a command, T must match the command's opcode */
+	template<typename T>
+	const T& GetCommand(const int32 Index) const
+	{
+		return *reinterpret_cast<const T*>(Commands[Index].GetMemory());
+	}
+
+	static EToastieCutsceneOpcode FindOpcode(const FInstancedStruct& Command);
+
+	/**
+	 * Compiles the control flow of InCommands. Returns false if the structure is broken, describing each problem in OutErrors.
+	 * Blocks that claim more commands than follow them are clamped, so the flow stays in range either way
+	 */
+	static bool CompileFlow(TConstArrayView<FInstancedStruct> InCommands, TArray<FToastieCutsceneFlowNode>& OutFlow,
+		TArray<int32>& OutChoiceOptions, TArray<FString>* OutErrors = nullptr);
+
+	/** Returns the index in Commands of the Label, or INDEX_NONE */
+	int32 FindLabel(const FName Label) const;
+
 	virtual void PostInitProperties() override;
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void PostLoad() override;
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
 	virtual void GetAssetRegistryTags(FAssetRegistryTagsContext Context) const override;
+
+	/**
+	 * Cooked builds store Commands as one packed blob: the command types once, then each command's binary data.
+	 * Serialize calls these when cooking and loading cooked data, the simulation commandlet's load benchmark calls them directly
+	 */
+	static void SavePackedCommands(FArchive& Ar, TArray<FInstancedStruct>& InCommands);
+	void LoadPackedCommands(FArchive& Ar);
 };
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/ChunkedArray.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/StreamableManager.h"
+#include "ToastieCutsceneAsset.h"
+#include "CutsceneProcessPool.h"
+#include "ToastieCutsceneSubsystem.generated.h"
+
+class ACutscenePlayer;
+
+DECLARE_DYNAMIC_DELEGATE_OneParam(FOnToastieCutsceneSceneLoaded, UToastieCutsceneAsset*, Scene);
+
+/**
+ * Runs every playing cutscene of the world. The processes of all Scenes live here and are ticked in one pass,
+ * calling into a CutscenePlayer only when one of its commands needs to run. Runs waiting on Blueprint or a delay are skipped.
+ * Also streams Scenes in the background, keeping them loaded while something uses them and releasing them
+ * once they've gone unused for SceneIdleReleaseTime seconds, and keeps a pool of reusable CutscenePlayers
+ */
+UCLASS(Config = Game)
+class TOASTIECUTSCENES_API UToastieCutsceneSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Starts loading Scene so it's ready by the time it's played */
+	UFUNCTION(BlueprintCallable, Category = "Toastie Cutscenes")
+	void PreloadScene(const TSoftObjectPtr<UToastieCutsceneAsset>& Scene);
+
+	/** Loads Scene and calls OnLoaded with it, or with nullptr if it couldn't be loaded. Scene stays loaded until ReleaseScene */
+	UFUNCTION(BlueprintCallable, Category = "Toastie Cutscenes")
+	void LoadScene(const TSoftObjectPtr<UToastieCutsceneAsset>& Scene, FOnToastieCutsceneSceneLoaded OnLoaded);
+
+	void LoadScene(const TSoftObjectPtr<UToastieCutsceneAsset>& Scene, TFunction<void(UToastieCutsceneAsset*)>&& OnLoaded);
+
+	/** Ends a use started by LoadScene, the Scene is released once it's been idle long enough */
+	UFUNCTION(BlueprintCallable, Category = "Toastie Cutscenes")
+	void ReleaseScene(const TSoftObjectPtr<UToastieCutsceneAsset>& Scene);
+
+	/** Plays Scene on an idle pooled player of PlayerClass, spawning one if none is free. The player returns to the pool when the Scene finishes */
+	UFUNCTION(BlueprintCallable, Category = "Toastie Cutscenes")
+	ACutscenePlayer* PlayScene(UToastieCutsceneAsset* Scene, TSubclassOf<ACutscenePlayer> PlayerClass);
+
+	/** Stops a player from PlayScene early and returns it to the pool */
+	UFUNCTION(BlueprintCallable, Category = "Toastie Cutscenes")
+	void StopScene(ACutscenePlayer* CutscenePlayer);
+
+	/** Starts ticking the processes of Scene for CutscenePlayer, returns a handle to the run */
+	int32 StartRun(ACutscenePlayer& CutscenePlayer, const UToastieCutsceneAsset& Scene);
+
+	/** Stops a run, safe to call while it's being ticked */
+	void StopRun(const int32 RunHandle);
+
+	/** Ticks a waiting run again on the next frame, after one of its commands finished */
+	void WakeRun(const int32 RunHandle);
+
+	FCutsceneProcessPool* GetRunProcessPool(const int32 RunHandle);
+
+	/** Seconds an unused Scene stays loaded */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "Toastie Cutscenes")
+	float SceneIdleReleaseTime = 30.0f;
+
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+private:
+
+	struct FStreamedScene
+	{
+		TSharedPtr<FStreamableHandle> Handle;
+		TArray<TFunction<void(UToastieCutsceneAsset*)>> PendingCallbacks;
+		int32 NumUsers = 0;
+		double IdleSince = 0.0;
+	};
+
+	struct FCutsceneRun
+	{
+		FCutsceneProcessPool ProcessPool;
+		TWeakObjectPtr<ACutscenePlayer> CutscenePlayer;
+		double LastTickTime = 0.0;
+
+		// World time the run next needs ticking, the largest double while it waits on Blueprint
+		double WakeTime = 0.0;
+
+		// Changes whenever the slot is reused, so a tick can tell its run was replaced by a handler
+		uint32 Serial = 0;
+		bool bActive = false;
+	};
+
+	// A run ticked this frame, with what it needs to be ticked in phases
+	struct FDueRun
+	{
+		int32 RunHandle = INDEX_NONE;
+		uint32 Serial = 0;
+		ACutscenePlayer* CutscenePlayer = nullptr;
+		float ElapsedTime = 0.0f;
+		bool bSettled = false;
+	};
+
+	bool IsValidRun(const int32 RunHandle) const;
+	bool IsDueRunActive(const FDueRun& DueRun) const;
+	void TickRuns();
+
+	// Chunked so a run keeps its address while handlers start new runs mid tick
+	TChunkedArray<FCutsceneRun> Runs;
+	TArray<int32> FreeRuns;
+	uint32 RunSerialCounter = 0;
+
+	// Kept between frames so gathering due runs doesn't allocate
+	TArray<FDueRun> DueRuns;
+
+	FStreamedScene& FindOrStreamScene(const FSoftObjectPath& ScenePath);
+	void OnSceneStreamed(FSoftObjectPath ScenePath);
+
+	UFUNCTION()
+	void OnPooledPlayerFinished(ACutscenePlayer* CutscenePlayer);
+
+	/** Pooled players that aren't playing anything */
+	UPROPERTY()
+	TArray<TObjectPtr<ACutscenePlayer>> IdlePlayers;
+
+	TMap<FSoftObjectPath, FStreamedScene> StreamedScenes;
+	FStreamableManager StreamableManager;
+};
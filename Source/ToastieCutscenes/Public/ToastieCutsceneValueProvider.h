@@ -0,0 +1,39 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Interface.h"
+#include "ToastieCutsceneAsset.h"
+#include "ToastieCutsceneValueProvider.generated.h"
+
+UINTERFACE(BlueprintType, meta = (CannotImplementInterfaceInBlueprint))
+class UToastieCutsceneValueProvider : public UInterface
+{
+	GENERATED_BODY()
+};
+
+/**
+ * Supplies the game values that Requirements are checked against, so a CutscenePlayer can check them
+ * natively instead of calling into Blueprint
+ */
+class TOASTIECUTSCENES_API IToastieCutsceneValueProvider
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Current value of Key, keys the game doesn't know about should be 0 */
+	virtual int32 GetCutsceneValue(const FName Key) const = 0;
+
+	/** Looks up every key at once. Override when the values can be fetched more cheaply together */
+	virtual void GetCutsceneValues(TConstArrayView<FName> Keys, TArrayView<int32> OutValues) const;
+
+	/** Whether values can be read from worker threads, letting scenes fetch their commands in parallel */
+	virtual bool CanReadValuesOnAnyThread() const { return false; }
+
+	/** Whether every requirement is met. A null Provider reads every value as 0 */
+	static bool AreRequirementsMet(const IToastieCutsceneValueProvider* Provider, const TArray<FToastieCutsceneReq>& Reqs);
+
+	/** Checks several lists of requirements with a single value lookup, such as the Options of a PlayerChoice */
+	static void AreRequirementsMet(const IToastieCutsceneValueProvider* Provider,
+		TConstArrayView<const TArray<FToastieCutsceneReq>*> RequirementLists, TArrayView<bool> OutMet);
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("ToastieCutscenes"), STATGROUP_ToastieCutscenes, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Tick"), STAT_ToastieCutscenes_Tick, STATGROUP_ToastieCutscenes, TOASTIECUTSCENES_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Fetch Commands"), STAT_ToastieCutscenes_FetchCommands, STATGROUP_ToastieCutscenes, TOASTIECUTSCENES_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Execute Command"), STAT_ToastieCutscenes_ExecuteCommand, STATGROUP_ToastieCutscenes, TOASTIECUTSCENES_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Requirements"), STAT_ToastieCutscenes_Requirements, STATGROUP_ToastieCutscenes, TOASTIECUTSCENES_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Find Label"), STAT_ToastieCutscenes_FindLabel, STATGROUP_ToastieCutscenes, TOASTIECUTSCENES_API);
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Active Players"), STAT_ToastieCutscenes_ActivePlayers, STATGROUP_ToastieCutscenes, TOASTIECUTSCENES_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Active Processes"), STAT_ToastieCutscenes_ActiveProcesses, STATGROUP_ToastieCutscenes, TOASTIECUTSCENES_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Active Commands"), STAT_ToastieCutscenes_ActiveCommands, STATGROUP_ToastieCutscenes, TOASTIECUTSCENES_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Queued Commands"), STAT_ToastieCutscenes_QueuedCommands, STATGROUP_ToastieCutscenes, TOASTIECUTSCENES_API);
+
+/** Times the enclosing scope with STAT_ToastieCutscenes_<Name> and shows it in Unreal Insights as ToastieCutscenes_<Name> */
+#define TOASTIECUTSCENES_SCOPE(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_ToastieCutscenes_##Name); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(ToastieCutscenes_##Name)
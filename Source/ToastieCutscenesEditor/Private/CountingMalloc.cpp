@@ -0,0 +1,14 @@
+#include "CountingMalloc.h"
+
+FCountingMalloc& FCountingMalloc::Install()
+{
+	// Memory allocated through it may be freed at any time after, so it's never swapped back out
+	static FCountingMalloc* CountingMalloc = nullptr;
+	check(IsInGameThread());
+	if (!CountingMalloc)
+	{
+		CountingMalloc = new FCountingMalloc(GMalloc);
+		GMalloc = CountingMalloc;
+	}
+	return *CountingMalloc;
+}
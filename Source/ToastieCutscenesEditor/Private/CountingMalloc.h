@@ -0,0 +1,131 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/MemoryBase.h"
+#include <atomic>
+
+/**
+ * Counts every allocation made through GMalloc while counting is on, on any thread or only the one that started counting.
+ * It's installed once and stays installed, while counting is off it only forwards to the allocator it wraps.
+ * Sizes come from the wrapped allocator, if it can't report them only the allocation count is meaningful
+ */
+class FCountingMalloc final : public FMalloc
+{
+public:
+	/** Wraps GMalloc the first time it's called, later calls return the same instance. Never removed */
+	static FCountingMalloc& Install();
+
+	/** Starts counting from zero. Allocations of other threads are ignored with bThisThreadOnly */
+	void StartCounting(const bool bThisThreadOnly = false)
+	{
+		NumAllocations = 0;
+		AllocatedBytes = 0;
+		LiveBytes = 0;
+		PeakBytes = 0;
+		CountingThreadId = bThisThreadOnly ? FPlatformTLS::GetCurrentThreadId() : 0;
+		bCounting = true;
+	}
+
+	void StopCounting()
+	{
+		bCounting = false;
+	}
+
+	int64 GetNumAllocations() const { return NumAllocations; }
+	int64 GetAllocatedBytes() const { return AllocatedBytes; }
+
+	// Highest memory held at once by allocations made since StartCounting
+	int64 GetPeakBytes() const { return PeakBytes; }
+
+	virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+	{
+		auto Result = Inner->Malloc(Count, Alignment);
+		if (IsCounting())
+		{
+			OnAllocated(GetSize(Result));
+		}
+		return Result;
+	}
+
+	virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+	{
+		if (!IsCounting())
+			return Inner->Realloc(Original, Count, Alignment);
+
+		const auto OldSize = GetSize(Original);
+		auto Result = Inner->Realloc(Original, Count, Alignment);
+		OnFreed(OldSize);
+		if (Result)
+		{
+			OnAllocated(GetSize(Result));
+		}
+		return Result;
+	}
+
+	virtual void Free(void* Original) override
+	{
+		if (IsCounting())
+		{
+			OnFreed(GetSize(Original));
+		}
+		Inner->Free(Original);
+	}
+
+	virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+	virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+	virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+	virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+	virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+	virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+	virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+private:
+	explicit FCountingMalloc(FMalloc* InInner)
+		: Inner(InInner)
+	{
+	}
+
+	bool IsCounting() const
+	{
+		if (!bCounting.load(std::memory_order_relaxed))
+			return false;
+
+		const auto ThreadId = CountingThreadId.load(std::memory_order_relaxed);
+		return ThreadId == 0 || ThreadId == FPlatformTLS::GetCurrentThreadId();
+	}
+
+	int64 GetSize(void* Ptr) const
+	{
+		SIZE_T Size = 0;
+		return Ptr && Inner->GetAllocationSize(Ptr, Size) ? static_cast<int64>(Size) : 0;
+	}
+
+	void OnAllocated(const int64 Size)
+	{
+		++NumAllocations;
+		AllocatedBytes += Size;
+
+		const auto Live = LiveBytes += Size;
+		auto Peak = PeakBytes.load();
+		while (Live > Peak && !PeakBytes.compare_exchange_weak(Peak, Live))
+		{
+		}
+	}
+
+	void OnFreed(const int64 Size)
+	{
+		// Memory allocated before counting started can take LiveBytes below zero, the peak is still relative
+		LiveBytes -= Size;
+	}
+
+	FMalloc* Inner;
+	std::atomic<bool> bCounting = false;
+
+	// Zero counts every thread
+	std::atomic<uint32> CountingThreadId = 0;
+
+	std::atomic<int64> NumAllocations = 0;
+	std::atomic<int64> AllocatedBytes = 0;
+	std::atomic<int64> LiveBytes = 0;
+	std::atomic<int64> PeakBytes = 0;
+};
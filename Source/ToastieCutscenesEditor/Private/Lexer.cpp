@@ -1,4 +1,8 @@
 #include "Lexer.h"
+#include "Internationalization/Regex.h"
+#include "ToastieCutscenesStats.h"
+
+DECLARE_CYCLE_STAT(TEXT("Import: Lex"), STAT_ToastieCutscenes_Lex, STATGROUP_ToastieCutscenes);
 
 namespace Lexer
 {
@@ -18,35 +22,168 @@ namespace Lexer
 		}
 	}
 
-	struct FTokenPatternEntry
+	// The scanner below tries each token type in this order at the current position and takes the first
+	// that matches. Each rule mirrors the pattern it was originally written as:
+	//
+	//	String		(")(.*)(")
+	//	Label		(\[)[A-Za-z_\-/0-9]+(\])
+	//	Say			[A-Za-z_\-/0-9]+:
+	//	Number		[0-9]*\.?[0-9]+
+	//	Identifier	[A-Za-z_\-/0-9]+
+	//	Comment		;(.*)
+	//	Whitespace	[ \t]+
+	//	NewLine		(\r\n|\r|\n)
+	//
+	// Every rule is anchored at the current position, so the whole input is scanned in a single pass.
+	// TryTokenizeRegex still lexes with the patterns themselves, any change here must keep the two in agreement.
+
+	static bool IsIdentifierChar(TCHAR C)
 	{
-		ETokenType Type;
-		FRegexPattern Pattern;
+		return (C >= TEXT('A') && C <= TEXT('Z'))
+			|| (C >= TEXT('a') && C <= TEXT('z'))
+			|| (C >= TEXT('0') && C <= TEXT('9'))
+			|| C == TEXT('_')
+			|| C == TEXT('-')
+			|| C == TEXT('/');
+	}
 
-		const FTokenPatternEntry(ETokenType AType, const TCHAR* APattern)
-			: Type(AType)
-			, Pattern(APattern) { }
-	};
+	static bool IsDigit(TCHAR C)
+	{
+		return C >= TEXT('0') && C <= TEXT('9');
+	}
 
-	static const TArray<FTokenPatternEntry> TokenPatterns =
+	// Characters that '.' does not match
+	static bool IsLineTerminator(TCHAR C)
 	{
-		FTokenPatternEntry(ETokenType::String,		TEXT("(\")(.*)(\")")),
-		FTokenPatternEntry(ETokenType::Label,		TEXT("(\\[)[A-Za-z_\\-/0-9]+(\\])")),
-		FTokenPatternEntry(ETokenType::Say,			TEXT("[A-Za-z_\\-/0-9]+:")),
-		FTokenPatternEntry(ETokenType::Number,		TEXT("[0-9]*\\.?[0-9]+")),
-		FTokenPatternEntry(ETokenType::Identifier,	TEXT("[A-Za-z_\\-/0-9]+")),
-		FTokenPatternEntry(ETokenType::Comment,		TEXT(";(.*)")),
-		FTokenPatternEntry(ETokenType::Whitespace,	TEXT("[ \t]+")),
-		FTokenPatternEntry(ETokenType::NewLine,		TEXT("(\r\n|\r|\n)"))
-	};
+		return C == TEXT('\n')
+			|| C == TEXT('\v')
+			|| C == TEXT('\f')
+			|| C == TEXT('\r')
+			|| C == TCHAR(0x0085)
+			|| C == TCHAR(0x2028)
+			|| C == TCHAR(0x2029);
+	}
+
+	static int32 CountWhile(const TCHAR* ABegin, const TCHAR* AEnd, bool (*APredicate)(TCHAR))
+	{
+		const TCHAR* It = ABegin;
+		while (It < AEnd && APredicate(*It))
+		{
+			++It;
+		}
+		return UE_PTRDIFF_TO_INT32(It - ABegin);
+	}
 
-	FSentence::FSentence(const TArray<FToken>& ATokens)
-		: Tokens()
+	static int32 CountUntilLineTerminator(const TCHAR* ABegin, const TCHAR* AEnd)
 	{
-		for (int I = 0; I < ATokens.Num(); ++I)
+		const TCHAR* It = ABegin;
+		while (It < AEnd && !IsLineTerminator(*It))
+		{
+			++It;
+		}
+		return UE_PTRDIFF_TO_INT32(It - ABegin);
+	}
+
+	static bool TryScanToken(const TCHAR* ACurrent, const TCHAR* AEnd, ETokenType& AType, int32& ALength)
+	{
+		const TCHAR C = *ACurrent;
+
+		// String: greedy, so it ends at the last quote on the line
+		if (C == TEXT('"'))
+		{
+			const int32 LineLength = CountUntilLineTerminator(ACurrent, AEnd);
+			for (int32 I = LineLength - 1; I > 0; --I)
+			{
+				if (ACurrent[I] == TEXT('"'))
+				{
+					AType = ETokenType::String;
+					ALength = I + 1;
+					return true;
+				}
+			}
+		}
+
+		// Label
+		if (C == TEXT('['))
+		{
+			const int32 NameLength = CountWhile(ACurrent + 1, AEnd, IsIdentifierChar);
+			if (NameLength > 0 && ACurrent + 1 + NameLength < AEnd && ACurrent[1 + NameLength] == TEXT(']'))
+			{
+				AType = ETokenType::Label;
+				ALength = NameLength + 2;
+				return true;
+			}
+		}
+
+		const int32 IdentifierLength = CountWhile(ACurrent, AEnd, IsIdentifierChar);
+
+		// Say
+		if (IdentifierLength > 0 && ACurrent + IdentifierLength < AEnd && ACurrent[IdentifierLength] == TEXT(':'))
+		{
+			AType = ETokenType::Say;
+			ALength = IdentifierLength + 1;
+			return true;
+		}
+
+		// Number: an optional fraction is only taken when at least one digit follows the dot
+		const int32 IntegerLength = CountWhile(ACurrent, AEnd, IsDigit);
+		const TCHAR* AfterInteger = ACurrent + IntegerLength;
+		if (AfterInteger < AEnd && *AfterInteger == TEXT('.'))
+		{
+			const int32 FractionLength = CountWhile(AfterInteger + 1, AEnd, IsDigit);
+			if (FractionLength > 0)
+			{
+				AType = ETokenType::Number;
+				ALength = IntegerLength + 1 + FractionLength;
+				return true;
+			}
+		}
+		if (IntegerLength > 0)
+		{
+			AType = ETokenType::Number;
+			ALength = IntegerLength;
+			return true;
+		}
+
+		// Identifier
+		if (IdentifierLength > 0)
+		{
+			AType = ETokenType::Identifier;
+			ALength = IdentifierLength;
+			return true;
+		}
+
+		// Comment
+		if (C == TEXT(';'))
+		{
+			AType = ETokenType::Comment;
+			ALength = CountUntilLineTerminator(ACurrent, AEnd);
+			return true;
+		}
+
+		// Whitespace
+		if (C == TEXT(' ') || C == TEXT('\t'))
+		{
+			AType = ETokenType::Whitespace;
+			ALength = CountWhile(ACurrent, AEnd, [](TCHAR Ch) { return Ch == TEXT(' ') || Ch == TEXT('\t'); });
+			return true;
+		}
+
+		// NewLine
+		if (C == TEXT('\r'))
+		{
+			AType = ETokenType::NewLine;
+			ALength = ACurrent + 1 < AEnd && ACurrent[1] == TEXT('\n') ? 2 : 1;
+			return true;
+		}
+		if (C == TEXT('\n'))
 		{
-			Tokens.Add(ATokens[I]);
+			AType = ETokenType::NewLine;
+			ALength = 1;
+			return true;
 		}
+
+		return false;
 	}
 
 	int32 FSentence::GetLineNumber() const
@@ -54,11 +191,16 @@ namespace Lexer
 		return IsValid() ? Tokens[0].LineNumber : -1;
 	}
 
-	const FString& FSentence::GetKeyword() const
+	FStringView FSentence::GetKeyword() const
 	{
 		return Tokens[0].Value;
 	}
 
+	void FSentence::AddToken(const FToken& AToken)
+	{
+		Tokens.Add(AToken);
+	}
+
 	void FSentence::Reset()
 	{
 		Tokens.Reset();
@@ -81,15 +223,15 @@ namespace Lexer
 
 	bool FSentence::IsKeywordSay() const
 	{
-		return IsValid() && Tokens[0].Value.EndsWith(TEXT(":"));
+		return IsValid() && Tokens[0].Value.EndsWith(TEXT(':'));
 	}
 
-	bool FSentence::KeywordIs(const FString& AName) const
+	bool FSentence::KeywordIs(FStringView AName) const
 	{
-		return IsValid() && Tokens[0].Value == AName;
+		return IsValid() && Tokens[0].Value.Equals(AName, ESearchCase::IgnoreCase);
 	}
 
-	bool FSentence::TryGetStringAtIndex(int32 AIndex, FString& AValue) const
+	bool FSentence::TryGetViewAtIndex(int32 AIndex, FStringView& AValue) const
 	{
 		if (Tokens.IsValidIndex(AIndex))
 		{
@@ -99,7 +241,24 @@ namespace Lexer
 		return false;
 	}
 
-	bool FSentence::TryGetStringProperty(const FString& AName, FString& AValue) const
+	bool FSentence::TryGetViewProperty(FStringView AName, FStringView& AValue) const
+	{
+		int32 Index;
+		return TryGetIndexOf(AName, Index) && TryGetViewAtIndex(Index + 1, AValue);
+	}
+
+	bool FSentence::TryGetStringAtIndex(int32 AIndex, FString& AValue) const
+	{
+		FStringView View;
+		if (TryGetViewAtIndex(AIndex, View))
+		{
+			AValue = View;
+			return true;
+		}
+		return false;
+	}
+
+	bool FSentence::TryGetStringProperty(FStringView AName, FString& AValue) const
 	{
 		int32 Index;
 		return TryGetIndexOf(AName, Index) && TryGetStringAtIndex(Index + 1, AValue);
@@ -109,10 +268,12 @@ namespace Lexer
 	{
 		if (Tokens.IsValidIndex(AIndex))
 		{
-			auto& ValueString = Tokens[AIndex].Value;
-			if (FCString::IsNumeric(*ValueString))
+			// Token values are not null terminated
+			TStringBuilder<64> ValueString;
+			ValueString << Tokens[AIndex].Value;
+			if (FCString::IsNumeric(ValueString.ToString()))
 			{
-				AValue = FCString::Atoi(*ValueString);
+				AValue = FCString::Atoi(ValueString.ToString());
 				return true;
 			}
 		}
@@ -120,7 +281,7 @@ namespace Lexer
 		return false;
 	}
 
-	bool FSentence::TryGetIntProperty(const FString& AName, int32& AValue) const
+	bool FSentence::TryGetIntProperty(FStringView AName, int32& AValue) const
 	{
 		int32 Index;
 		return TryGetIndexOf(AName, Index) && TryGetIntAtIndex(Index + 1, AValue);
@@ -130,10 +291,11 @@ namespace Lexer
 	{
 		if (Tokens.IsValidIndex(AIndex))
 		{
-			auto& ValueString = Tokens[AIndex].Value;
-			if (FCString::IsNumeric(*ValueString))
+			TStringBuilder<64> ValueString;
+			ValueString << Tokens[AIndex].Value;
+			if (FCString::IsNumeric(ValueString.ToString()))
 			{
-				AValue = FCString::Atod(*ValueString);
+				AValue = FCString::Atod(ValueString.ToString());
 				return true;
 			}
 		}
@@ -141,23 +303,23 @@ namespace Lexer
 		return false;
 	}
 
-	bool FSentence::TryGetDoubleProperty(const FString& AName, double& AValue) const
+	bool FSentence::TryGetDoubleProperty(FStringView AName, double& AValue) const
 	{
 		int32 Index;
 		return TryGetIndexOf(AName, Index) && TryGetDoubleAtIndex(Index + 1, AValue);
 	}
 
-	bool FSentence::Contains(const FString& AName) const
+	bool FSentence::Contains(FStringView AName) const
 	{
 		int32 Index;
 		return TryGetIndexOf(AName, Index);
 	}
 
-	bool FSentence::TryGetIndexOf(const FString& AName, int32& AIndex) const
+	bool FSentence::TryGetIndexOf(FStringView AName, int32& AIndex) const
 	{
 		for (int32 I = 0; I < Tokens.Num(); ++I)
 		{
-			if (Tokens[I].Value == AName)
+			if (Tokens[I].Value.Equals(AName, ESearchCase::IgnoreCase))
 			{
 				AIndex = I;
 				return true;
@@ -167,7 +329,87 @@ namespace Lexer
 		return false;
 	}
 
-	bool TryTokenize(const FString& AInput, TArray<FSentence>& ASentences)
+	bool TryTokenize(FStringView AInput, TArray<FSentence>& ASentences)
+	{
+		TOASTIECUTSCENES_SCOPE(Lex);
+		ASentences.Reset();
+		ASentences.Add(FSentence());
+
+		int32 LineNumber = 1;
+		int32 ColumnNumber = 1;
+
+		const TCHAR* Begin = AInput.GetData();
+		const TCHAR* End = Begin + AInput.Len();
+		const TCHAR* Current = Begin;
+		while (Current < End)
+		{
+			ETokenType Type;
+			int32 MatchLen;
+
+			// If no match was found, we error out
+			if (!TryScanToken(Current, End, Type, MatchLen))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("TCS: Unable to find match at Line %d, Column %d"), LineNumber, ColumnNumber);
+				return false;
+			}
+
+			if (Type != ETokenType::Whitespace &&
+				Type != ETokenType::NewLine)
+			{
+				ASentences.Last().AddToken(FToken(Type, FStringView(Current, MatchLen), LineNumber, ColumnNumber));
+			}
+
+			if (Type == ETokenType::NewLine)
+			{
+				ColumnNumber = 1;
+				LineNumber += 1;
+
+				if (ASentences.Last().IsValid())
+					ASentences.Add(FSentence());
+				else
+					ASentences.Last().Reset();
+			}
+			else
+			{
+				ColumnNumber += MatchLen;
+			}
+
+			Current += MatchLen;
+		}
+
+		// Sentences are only completed by a line break
+		ASentences.Last().Reset();
+
+		return true;
+	}
+
+	struct FTokenPatternEntry
+	{
+		ETokenType Type;
+		FRegexPattern Pattern;
+
+		FTokenPatternEntry(ETokenType AType, const TCHAR* APattern)
+			: Type(AType)
+			, Pattern(APattern) { }
+	};
+
+	static const TArray<FTokenPatternEntry>& GetTokenPatterns()
+	{
+		static const TArray<FTokenPatternEntry> TokenPatterns =
+		{
+			FTokenPatternEntry(ETokenType::String,		TEXT("(\")(.*)(\")")),
+			FTokenPatternEntry(ETokenType::Label,		TEXT("(\\[)[A-Za-z_\\-/0-9]+(\\])")),
+			FTokenPatternEntry(ETokenType::Say,			TEXT("[A-Za-z_\\-/0-9]+:")),
+			FTokenPatternEntry(ETokenType::Number,		TEXT("[0-9]*\\.?[0-9]+")),
+			FTokenPatternEntry(ETokenType::Identifier,	TEXT("[A-Za-z_\\-/0-9]+")),
+			FTokenPatternEntry(ETokenType::Comment,		TEXT(";(.*)")),
+			FTokenPatternEntry(ETokenType::Whitespace,	TEXT("[ \t]+")),
+			FTokenPatternEntry(ETokenType::NewLine,		TEXT("(\r\n|\r|\n)"))
+		};
+		return TokenPatterns;
+	}
+
+	bool TryTokenizeRegex(FStringView AInput, TArray<FSentence>& ASentences)
 	{
 		struct FTokenMatcher
 		{
@@ -182,26 +424,28 @@ namespace Lexer
 		ASentences.Reset();
 		ASentences.Add(FSentence());
 
+		// Matching needs its own copy, tokens still point into AInput at the same offsets
+		const FString Input(AInput);
+
 		// Create matchers for each token pattern
 		TArray<FTokenMatcher> TokenMatchers;
-		for (auto& TokenPattern : TokenPatterns)
+		for (auto& TokenPattern : GetTokenPatterns())
 		{
-			TokenMatchers.Add(FTokenMatcher(TokenPattern, AInput));
+			TokenMatchers.Add(FTokenMatcher(TokenPattern, Input));
 		}
 
-		TArray<FToken> CurrentTokens;
 		int32 LineNumber = 1;
 		int32 ColumnNumber = 1;
 
 		int32 Current = 0;
-		while (Current < AInput.Len())
+		while (Current < Input.Len())
 		{
 			auto bMatchFound = false;
 
 			// Find the first matching pattern
 			for (auto& TokenMatcher : TokenMatchers)
 			{
-				TokenMatcher.Matcher.SetLimits(Current, AInput.Len());
+				TokenMatcher.Matcher.SetLimits(Current, Input.Len());
 
 				if (TokenMatcher.Matcher.FindNext() && TokenMatcher.Matcher.GetMatchBeginning() - Current == 0)
 				{
@@ -214,7 +458,7 @@ namespace Lexer
 						TokenMatcher.PatternEntry.Type != ETokenType::NewLine)
 					{
 						const auto MatchValue = AInput.Mid(MatchBegin, MatchLen);
-						CurrentTokens.Add(FToken(TokenMatcher.PatternEntry.Type, MatchValue, LineNumber, ColumnNumber));
+						ASentences.Last().AddToken(FToken(TokenMatcher.PatternEntry.Type, MatchValue, LineNumber, ColumnNumber));
 					}
 
 					if (TokenMatcher.PatternEntry.Type == ETokenType::NewLine)
@@ -222,11 +466,10 @@ namespace Lexer
 						ColumnNumber = 1;
 						LineNumber += 1;
 
-						ASentences.Last() = FSentence(CurrentTokens);
 						if (ASentences.Last().IsValid())
 							ASentences.Add(FSentence());
-
-						CurrentTokens.Reset();
+						else
+							ASentences.Last().Reset();
 					}
 					else
 					{
@@ -241,11 +484,14 @@ namespace Lexer
 			// If no match was found, we error out
 			if (!bMatchFound)
 			{
-				UE_LOG(LogTemp, Warning, TEXT("TCS: Unable to find match"));
+				UE_LOG(LogTemp, Warning, TEXT("TCS: Unable to find match at Line %d, Column %d"), LineNumber, ColumnNumber);
 				return false;
 			}
 		}
 
+		// Sentences are only completed by a line break
+		ASentences.Last().Reset();
+
 		return true;
 	}
-}
\ No newline at end of file
+}
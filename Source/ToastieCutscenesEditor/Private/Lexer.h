@@ -21,10 +21,14 @@ namespace Lexer
 
 	const TCHAR* GetTokenTypeName(ETokenType AType);
 
+	/// <summary>
+	/// Tokens do not own their text. Value is a view into the source buffer passed to TryTokenize,
+	/// which must outlive every token and sentence produced from it.
+	/// </summary>
 	struct FToken
 	{
 		ETokenType Type = ETokenType::Invalid;
-		FString Value = FString();
+		FStringView Value = FStringView();
 		int LineNumber = 0;
 		int ColumnNumber = 0;
 
@@ -34,38 +38,48 @@ namespace Lexer
 	struct FSentence
 	{
 	private:
-		TArray<FToken> Tokens;
+		TArray<FToken, TInlineAllocator<8>> Tokens;
 
 	public:
 		FSentence() = default;
-		FSentence(const TArray<FToken>& ATokens);
 
 		int32 GetLineNumber() const;
-		const FString& GetKeyword() const;
+		FStringView GetKeyword() const;
+		TConstArrayView<FToken> GetTokens() const { return Tokens; }
 
+		void AddToken(const FToken& AToken);
 		void Reset();
 		bool IsValid() const;
 		bool IsComment() const;
 		bool IsLabel() const;
 
 		bool IsKeywordSay() const;
-		bool KeywordIs(const FString& AName) const;
+		bool KeywordIs(FStringView AName) const;
+
+		bool TryGetViewAtIndex(int32 AIndex, FStringView& AValue) const;
+		bool TryGetViewProperty(FStringView AName, FStringView& AValue) const;
 
 		bool TryGetStringAtIndex(int32 AIndex, FString& AValue) const;
-		bool TryGetStringProperty(const FString& AName, FString& AValue) const;
+		bool TryGetStringProperty(FStringView AName, FString& AValue) const;
 
 		bool TryGetIntAtIndex(int32 AIndex, int32& AValue) const;
-		bool TryGetIntProperty(const FString& AName, int32& AValue) const;
+		bool TryGetIntProperty(FStringView AName, int32& AValue) const;
 
 		bool TryGetDoubleAtIndex(int32 AIndex, double& AValue) const;
-		bool TryGetDoubleProperty(const FString& AName, double& AValue) const;
+		bool TryGetDoubleProperty(FStringView AName, double& AValue) const;
 
-		bool Contains(const FString& AName) const;
+		bool Contains(FStringView AName) const;
 
 	private:
 
-		bool TryGetIndexOf(const FString& AName, int32& AIndex) const;
+		bool TryGetIndexOf(FStringView AName, int32& AIndex) const;
 	};
 
-	bool TryTokenize(const FString& AInput, TArray<FSentence>& ASentences);
+	bool TryTokenize(FStringView AInput, TArray<FSentence>& ASentences);
+
+	/// <summary>
+	/// The regex lexer TryTokenize replaced, kept as the reference it must match.
+	/// ToastieCutscenesLexer compares the two on a corpus. Much slower, not used for importing.
+	/// </summary>
+	bool TryTokenizeRegex(FStringView AInput, TArray<FSentence>& ASentences);
 }
@@ -0,0 +1,978 @@
+#include "Parser.h"
+#include "ToastieCutsceneAsset.h"
+#include "ToastieCutsceneAssetFactory.h"
+#include "ToastieCutscenesStats.h"
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "Async/ParallelFor.h"
+#include "Hash/xxhash.h"
+#include "Internationalization/StringTable.h"
+#include "Internationalization/StringTableCore.h"
+#include "Logging/StructuredLog.h"
+#include "ObjectTools.h"
+#include "PackageTools.h"
+#include "Misc/Paths.h"
+
+DECLARE_CYCLE_STAT(TEXT("Import: Split Scenes"), STAT_ToastieCutscenes_SplitScenes, STATGROUP_ToastieCutscenes);
+DECLARE_CYCLE_STAT(TEXT("Import: Parse Scenes"), STAT_ToastieCutscenes_ParseScenes, STATGROUP_ToastieCutscenes);
+DECLARE_CYCLE_STAT(TEXT("Import: String Table"), STAT_ToastieCutscenes_StringTable, STATGROUP_ToastieCutscenes);
+DECLARE_CYCLE_STAT(TEXT("Import: Create Assets"), STAT_ToastieCutscenes_CreateAssets, STATGROUP_ToastieCutscenes);
+
+namespace Parser
+{
+#define DEFINE_TCS_KEYWORD(Name) const static FString Keyword##Name(TEXT(#Name))
+
+	// Modifiers, these are never the first token of a sentence
+	DEFINE_TCS_KEYWORD(Dialogue);
+	DEFINE_TCS_KEYWORD(Concurrent);
+
+	FKeywordTable& FKeywordTable::Get()
+	{
+		static FKeywordTable Instance;
+		return Instance;
+	}
+
+	void FKeywordTable::Initialize()
+	{
+		Entries.Reset();
+		ResetStructBindings();
+
+		Entries.Add(FName(TEXT("Scene")), FKeywordEntry { EKeyword::Scene, nullptr });
+		Entries.Add(FName(TEXT("EndScene")), FKeywordEntry { EKeyword::EndScene, nullptr });
+		Entries.Add(FName(TEXT("Block")), FKeywordEntry { EKeyword::Block, nullptr });
+		Entries.Add(FName(TEXT("EndBlock")), FKeywordEntry { EKeyword::EndBlock, nullptr });
+		Entries.Add(FName(TEXT("PlayerChoice")), FKeywordEntry { EKeyword::PlayerChoice, nullptr });
+		Entries.Add(FName(TEXT("EndPlayerChoice")), FKeywordEntry { EKeyword::EndPlayerChoice, nullptr });
+		Entries.Add(FName(TEXT("Define")), FKeywordEntry { EKeyword::Define, nullptr });
+
+		RegisterCommandType(FToastieCutsceneReq::StaticStruct());
+		RegisterCommandType(FToastieCutsceneEnablePlayerControl::StaticStruct());
+		RegisterCommandType(FToastieCutsceneDisablePlayerControl::StaticStruct());
+		RegisterCommandType(FToastieCutsceneWait::StaticStruct());
+		RegisterCommandType(FToastieCutsceneLookAt::StaticStruct());
+		RegisterCommandType(FToastieCutsceneExit::StaticStruct());
+		RegisterCommandType(FToastieCutsceneGoto::StaticStruct());
+		RegisterCommandType(FToastieCutsceneOption::StaticStruct());
+	}
+
+	void FKeywordTable::Shutdown()
+	{
+		Entries.Empty();
+		ResetStructBindings();
+	}
+
+	bool FKeywordTable::RegisterCommandType(const UScriptStruct* CommandType)
+	{
+		check(IsInGameThread());
+
+		const auto CommandTypeKeywordPtr = CommandType ? CommandType->FindMetaData("TCS") : nullptr;
+		if (!CommandTypeKeywordPtr || CommandTypeKeywordPtr->IsEmpty())
+		{
+			UE_LOGFMT(TCSImporter, Error, "Unable to register TCS Command {0}, it has no TCS meta", GetNameSafe(CommandType));
+			return false;
+		}
+
+		const FName Keyword(**CommandTypeKeywordPtr);
+		if (const auto Existing = Entries.Find(Keyword))
+		{
+			UE_LOGFMT(TCSImporter, Error, "Unable to register TCS Command {0}, keyword \"{1}\" is already used by {2}", CommandType->GetName(), *CommandTypeKeywordPtr, Existing->CommandType ? Existing->CommandType->GetName() : TEXT("the parser"));
+			return false;
+		}
+
+		Entries.Add(Keyword, FKeywordEntry { EKeyword::Command, CommandType });
+		return true;
+	}
+
+	void FKeywordTable::UnregisterCommandType(const UScriptStruct* CommandType)
+	{
+		check(IsInGameThread());
+
+		for (auto It = Entries.CreateIterator(); It; ++It)
+		{
+			if (It->Value.Keyword == EKeyword::Command && It->Value.CommandType == CommandType)
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+
+	const FKeywordEntry* FKeywordTable::Find(const Lexer::FSentence& Sentence) const
+	{
+		if (!Sentence.IsValid() || Sentence.IsLabel() || Sentence.IsKeywordSay())
+		{
+			return nullptr;
+		}
+
+		// Only look up names that already exist, every keyword was added when it was registered
+		const auto Keyword = Sentence.GetKeyword();
+		if (Keyword.Len() >= NAME_SIZE)
+		{
+			return nullptr;
+		}
+
+		const FName KeywordName(Keyword.Len(), Keyword.GetData(), FNAME_Find);
+		return KeywordName.IsNone() ? nullptr : Entries.Find(KeywordName);
+	}
+
+	const UScriptStruct* TryFindCommandType(const Lexer::FSentence& Sentence, const FKeywordEntry* KeywordEntry)
+	{
+		if (Sentence.IsKeywordSay())
+		{
+			return FToastieCutsceneSay::StaticStruct();
+		}
+		if (KeywordEntry && KeywordEntry->Keyword == EKeyword::Command)
+		{
+			return KeywordEntry->CommandType;
+		}
+		return nullptr;
+	}
+
+	// Token values are views into the source buffer and are not null terminated
+	template<typename T>
+	T ParseNumber(FStringView Input, T (*Parse)(const TCHAR*))
+	{
+		TStringBuilder<64> Builder;
+		Builder << Input;
+		return Parse(Builder.ToString());
+	}
+
+	FString SanitizeString(
+		FStringView Input,
+		const Lexer::FSentence& Sentence,
+		const TMap<FString, FString>* Defines = nullptr)
+	{
+		FStringView Trimmed = Input;
+
+		if (Sentence.IsKeywordSay() && Input.EndsWith(TEXT(':')))
+		{
+			Trimmed.LeftChopInline(1);
+		}
+		else
+		{
+			if (Input.StartsWith(TEXT('"')))
+			{
+				Trimmed.RightChopInline(1);
+			}
+			if (Input.Len() > 1 && Input.EndsWith(TEXT('"')))
+			{
+				Trimmed.LeftChopInline(1);
+			}
+		}
+
+		// This is the only place a token's text is copied out of the source buffer
+		FString Output(Trimmed);
+
+		if (Defines)
+		{
+			auto Define = Defines->Find(Output);
+			if (Define)
+			{
+				return *Define;
+			}
+		}
+
+		return Output;
+	}
+
+	/// <summary>
+	/// Everything DeserializeStruct needs to know about a single field of a command struct.
+	/// Built once per UScriptStruct from its reflection data and metadata.
+	/// </summary>
+	struct FFieldBinding
+	{
+		struct FInput
+		{
+			const Lexer::FSentence& Sentence;
+			const TMap<FString, FString>* Defines;
+			FStringView Value;
+			bool bKeyFound;
+		};
+
+		using FSetter = void (*)(const FFieldBinding& Binding, void* StructPtr, const FInput& Input);
+
+		const FProperty* Property = nullptr;
+		int32 Offset = 0;
+		FSetter Setter = nullptr;
+		int32 Index = INDEX_NONE;
+		FString PropertyName;
+
+		template<typename T>
+		T& GetValue(void* StructPtr) const
+		{
+			return *reinterpret_cast<T*>(static_cast<uint8*>(StructPtr) + Offset);
+		}
+	};
+
+	struct FStructBinding
+	{
+		TArray<FFieldBinding> Fields;
+	};
+
+	void SetBoolField(const FFieldBinding& Binding, void* StructPtr, const FFieldBinding::FInput& Input)
+	{
+		// Bool properties may be bitfields, so let the property do the write
+		static_cast<const FBoolProperty*>(Binding.Property)->SetPropertyValue_InContainer(StructPtr, Input.bKeyFound);
+	}
+
+	template<typename T, T (*Parse)(const TCHAR*)>
+	void SetNumberField(const FFieldBinding& Binding, void* StructPtr, const FFieldBinding::FInput& Input)
+	{
+		Binding.GetValue<T>(StructPtr) = ParseNumber(Input.Value, Parse);
+	}
+
+	void SetStringField(const FFieldBinding& Binding, void* StructPtr, const FFieldBinding::FInput& Input)
+	{
+		Binding.GetValue<FString>(StructPtr) = SanitizeString(Input.Value, Input.Sentence, Input.Defines);
+	}
+
+	void SetNameField(const FFieldBinding& Binding, void* StructPtr, const FFieldBinding::FInput& Input)
+	{
+		Binding.GetValue<FName>(StructPtr) = FName(SanitizeString(Input.Value, Input.Sentence, Input.Defines));
+	}
+
+	void SetTextField(const FFieldBinding& Binding, void* StructPtr, const FFieldBinding::FInput& Input)
+	{
+		Binding.GetValue<FText>(StructPtr) = FText::FromString(SanitizeString(Input.Value, Input.Sentence, Input.Defines));
+	}
+
+	FFieldBinding::FSetter FindSetter(const FProperty* Property)
+	{
+		if (Property->IsA<FBoolProperty>())		return &SetBoolField;
+		if (Property->IsA<FIntProperty>())		return &SetNumberField<int32, &FCString::Atoi>;
+		if (Property->IsA<FFloatProperty>())	return &SetNumberField<float, &FCString::Atof>;
+		if (Property->IsA<FDoubleProperty>())	return &SetNumberField<double, &FCString::Atod>;
+		if (Property->IsA<FStrProperty>())		return &SetStringField;
+		if (Property->IsA<FNameProperty>())		return &SetNameField;
+		if (Property->IsA<FTextProperty>())		return &SetTextField;
+		return nullptr;
+	}
+
+	// Scenes are parsed in parallel, bindings are built by whichever thread sees the struct first
+	static TMap<const UScriptStruct*, TUniquePtr<FStructBinding>> StructBindings;
+	static FRWLock StructBindingsLock;
+
+	void ResetStructBindings()
+	{
+		FWriteScopeLock WriteLock(StructBindingsLock);
+		StructBindings.Empty();
+	}
+
+	const FStructBinding& GetStructBinding(const UScriptStruct* CommandType)
+	{
+		{
+			FReadScopeLock ReadLock(StructBindingsLock);
+			if (const auto Existing = StructBindings.Find(CommandType))
+			{
+				return **Existing;
+			}
+		}
+
+		FWriteScopeLock WriteLock(StructBindingsLock);
+		if (const auto Existing = StructBindings.Find(CommandType))
+		{
+			return **Existing;
+		}
+
+		auto& Binding = StructBindings.Add(CommandType, MakeUnique<FStructBinding>());
+		for (TFieldIterator<FProperty> It(CommandType); It; ++It)
+		{
+			FFieldBinding Field;
+			Field.Property = *It;
+			Field.Offset = It->GetOffset_ForInternal();
+			Field.Setter = FindSetter(*It);
+
+			if (const auto MetaIndex = It->FindMetaData("Index"))
+			{
+				Field.Index = FCString::Atoi(**MetaIndex);
+			}
+
+			if (const auto MetaPropertyName = It->FindMetaData("Property"))
+			{
+				Field.PropertyName = *MetaPropertyName;
+			}
+
+			// Unsupported types are still bound when they have an Index,
+			// a missing value at that index fails the command
+			if (Field.Setter || Field.Index != INDEX_NONE)
+			{
+				Binding->Fields.Add(MoveTemp(Field));
+			}
+		}
+
+		return *Binding;
+	}
+
+	bool DeserializeStruct(
+		const UScriptStruct* CommandType,
+		const Lexer::FSentence& Sentence,
+		FInstancedStruct& OutStruct,
+		const TMap<FString, FString>* Defines = nullptr)
+	{
+		OutStruct.InitializeAs(CommandType);
+
+		auto StructPtr = (void*)OutStruct.GetMutableMemory();
+
+		for (const auto& Field : GetStructBinding(CommandType).Fields)
+		{
+			FFieldBinding::FInput Input { Sentence, Defines, FStringView(), false };
+
+			if (Field.Index != INDEX_NONE)
+			{
+				// The value for this field can be found at the specified index in the sentence
+				if (!Sentence.TryGetViewAtIndex(Field.Index, Input.Value))
+				{
+					UE_LOGFMT(TCSImporter, Error, "Synatx Error: Could not find Value at Index {0} for Command {1} at Line {2}", Field.Index, CommandType->GetName(), Sentence.GetLineNumber());
+					OutStruct.Reset();
+					return false;
+				}
+
+				Input.bKeyFound = true;
+			}
+
+			if (!Field.PropertyName.IsEmpty())
+			{
+				Input.bKeyFound = Sentence.Contains(Field.PropertyName);
+				Sentence.TryGetViewProperty(Field.PropertyName, Input.Value);
+			}
+
+			if (Field.Setter)
+			{
+				Field.Setter(Field, StructPtr, Input);
+			}
+		}
+
+		return true;
+	}
+
+	// Bump whenever the same source would produce different commands, so reimports rebuild every Scene
+	static constexpr uint32 ImporterVersion = 3;
+
+	void UpdateHash(FXxHash64Builder& Builder, FStringView String)
+	{
+		const int32 Len = String.Len();
+		Builder.Update(&Len, sizeof(Len));
+		Builder.Update(String.GetData(), Len * sizeof(TCHAR));
+	}
+
+	uint64 HashSceneSource(const TArray<Lexer::FSentence>& ASentences, const FSceneRange& ASceneRange)
+	{
+		FXxHash64Builder Builder;
+		Builder.Update(&ImporterVersion, sizeof(ImporterVersion));
+
+		for (const auto& Define : *ASceneRange.Defines)
+		{
+			UpdateHash(Builder, Define.Key);
+			UpdateHash(Builder, Define.Value);
+		}
+
+		for (int32 I = ASceneRange.FirstSentence; I <= ASceneRange.EndSentence; ++I)
+		{
+			for (const auto& Token : ASentences[I].GetTokens())
+			{
+				UpdateHash(Builder, Token.Value);
+			}
+		}
+
+		return Builder.Finalize().Hash;
+	}
+
+	bool TryAddDefine(const Lexer::FSentence& Sentence, TMap<FString, FString>& Defines)
+	{
+		FInstancedStruct Define;
+		if (DeserializeStruct(FToastieCutsceneDefine::StaticStruct(), Sentence, Define))
+		{
+			auto DefineData = Define.Get<FToastieCutsceneDefine>();
+			if (!DefineData.InputName.IsEmpty() && !DefineData.OutputName.IsEmpty())
+			{
+				Defines.Add(DefineData.InputName, DefineData.OutputName);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool TrySplitScenes(
+		const TArray<Lexer::FSentence>& ASentences,
+		TArray<FSceneRange>& ASceneRanges)
+	{
+		ASceneRanges.Reset();
+
+		// Each range gets the Defines made before it, Defines inside a Scene are applied again when it is parsed
+		auto Defines = MakeShared<TMap<FString, FString>>();
+		FSceneRange CurrentRange;
+		CurrentRange.Defines = Defines;
+
+		for (int32 I = 0; I < ASentences.Num(); ++I)
+		{
+			auto& Sentence = ASentences[I];
+
+			if (!Sentence.IsValid() || Sentence.IsComment())
+				continue;
+
+			const auto KeywordEntry = FKeywordTable::Get().Find(Sentence);
+			const auto Keyword = KeywordEntry ? KeywordEntry->Keyword : EKeyword::None;
+
+			if (Keyword == EKeyword::Define)
+			{
+				auto NewDefines = MakeShared<TMap<FString, FString>>(*Defines);
+				if (TryAddDefine(Sentence, *NewDefines))
+				{
+					Defines = NewDefines;
+				}
+			}
+			else if (Keyword == EKeyword::Scene)
+			{
+				if (!CurrentRange.Name.IsEmpty())
+				{
+					UE_LOGFMT(TCSImporter, Error, "Syntax Error: Attempting to start new Scene before ending previous Scene in Line {0}", Sentence.GetLineNumber());
+					return false;
+				}
+
+				if (!Sentence.TryGetStringAtIndex(1, CurrentRange.Name))
+				{
+					UE_LOGFMT(TCSImporter, Error, "Syntax Error: Expected Name after Scene in Line {0}", Sentence.GetLineNumber());
+					return false;
+				}
+
+				CurrentRange.bDialogue = Sentence.Contains(KeywordDialogue);
+			}
+			else if (Keyword == EKeyword::EndScene)
+			{
+				if (CurrentRange.Name.IsEmpty())
+				{
+					UE_LOGFMT(TCSImporter, Error, "EndScene found with no valid Scene. Line {0}", Sentence.GetLineNumber());
+					return false;
+				}
+
+				// Commands between the previous EndScene and this Scene belong to this Scene
+				CurrentRange.EndSentence = I;
+				CurrentRange.SourceHash = HashSceneSource(ASentences, CurrentRange);
+				ASceneRanges.Add(MoveTemp(CurrentRange));
+
+				CurrentRange = FSceneRange();
+				CurrentRange.FirstSentence = I + 1;
+				CurrentRange.Defines = Defines;
+			}
+		}
+		return true;
+	}
+
+	bool TryCompileFlow(const FScene& AScene)
+	{
+		TSet<FName> Labels;
+		for (const auto& Command : AScene.Commands)
+		{
+			if (const auto LabelPtr = Command.GetPtr<FToastieCutsceneLabel>();
+				LabelPtr)
+			{
+				bool bAlreadyDefined = false;
+				Labels.Add(LabelPtr->Label, &bAlreadyDefined);
+				if (bAlreadyDefined)
+				{
+					UE_LOGFMT(TCSImporter, Warning, "Label {0} is defined more than once in Scene {1}, only the first is used", LabelPtr->Label, AScene.Name);
+				}
+			}
+		}
+
+		// The asset compiles its own flow when the Scene is applied, this pass only validates the structure
+		TArray<FToastieCutsceneFlowNode> Flow;
+		TArray<int32> ChoiceOptions;
+		TArray<FString> Errors;
+		if (UToastieCutsceneAsset::CompileFlow(AScene.Commands, Flow, ChoiceOptions, &Errors))
+		{
+			return true;
+		}
+
+		for (const auto& Error : Errors)
+		{
+			UE_LOGFMT(TCSImporter, Error, "Syntax Error: {0} in Scene {1}", Error, AScene.Name);
+		}
+		return false;
+	}
+
+	bool TryParseScene(
+		const TArray<Lexer::FSentence>& ASentences,
+		const FSceneRange& ASceneRange,
+		FScene& AScene)
+	{
+		TArray<int32> BlockIndices;
+		const TMap<FString, FString>* Defines = ASceneRange.Defines.Get();
+		TMap<FString, FString> SceneDefines;
+
+		AScene.Reset();
+		AScene.Name = ASceneRange.Name;
+		AScene.bDialogue = ASceneRange.bDialogue;
+		AScene.SourceHash = ASceneRange.SourceHash;
+
+		for (int32 I = ASceneRange.FirstSentence; I < ASceneRange.EndSentence; ++I)
+		{
+			auto& Sentence = ASentences[I];
+
+			if (!Sentence.IsValid() || Sentence.IsComment())
+				continue;
+
+			const auto KeywordEntry = FKeywordTable::Get().Find(Sentence);
+			const auto Keyword = KeywordEntry ? KeywordEntry->Keyword : EKeyword::None;
+
+			/// <summary>
+			/// Define
+			/// </summary>
+			if (Keyword == EKeyword::Define)
+			{
+				// Copy the shared Defines the first time this Scene makes its own
+				if (Defines != &SceneDefines)
+				{
+					SceneDefines = *Defines;
+					Defines = &SceneDefines;
+				}
+				TryAddDefine(Sentence, SceneDefines);
+			}
+
+			/// <summary>
+			/// Scene and EndScene are handled by TrySplitScenes
+			/// </summary>
+			else if (Keyword == EKeyword::Scene || Keyword == EKeyword::EndScene)
+			{
+			}
+
+			/// <summary>
+			/// Blocks
+			/// </summary>
+			else if (Keyword == EKeyword::Block || Keyword == EKeyword::PlayerChoice)
+			{
+				auto Struct = FInstancedStruct::Make<FToastieCutsceneBlock>();
+				auto BlockPtr = Struct.GetMutablePtr<FToastieCutsceneBlock>();
+
+				if (Keyword == EKeyword::PlayerChoice)
+				{
+					BlockPtr->Type = EToastieCutsceneBlockType::PlayerChoice;
+				}
+				else
+				{
+					BlockPtr->Type = Sentence.Contains(KeywordConcurrent)
+						? EToastieCutsceneBlockType::Concurrent
+						: EToastieCutsceneBlockType::Sequential;
+				}
+				BlockPtr->CommandCount = 0;
+
+				BlockIndices.Add(AScene.Commands.Num());
+				AScene.Commands.Add(MoveTemp(Struct));
+			}
+
+			/// <summary>
+			/// EndBlocks
+			/// </summary>
+			else if (Keyword == EKeyword::EndBlock || Keyword == EKeyword::EndPlayerChoice)
+			{
+				if (BlockIndices.IsEmpty())
+				{
+					UE_LOGFMT(TCSImporter, Error, "Synatx Error: EndBlock found with no corresponding Block. Line {0}", Sentence.GetLineNumber());
+					return false;
+				}
+
+				auto Index = BlockIndices.Pop();
+				auto& Struct = AScene.Commands[Index];
+				auto BlockPtr = Struct.GetMutablePtr<FToastieCutsceneBlock>();
+				if (!BlockPtr)
+				{
+					UE_LOGFMT(TCSImporter, Error, "Synatx Error: Unable to find corresponding Block for EndBlock in Line {0}", Sentence.GetLineNumber());
+					return false;
+				}
+
+				BlockPtr->CommandCount = AScene.Commands.Num() - Index - 1;
+			}
+
+			/// <summary>
+			/// Label
+			/// </summary>
+			else if (Sentence.IsLabel())
+			{
+				auto Struct = FInstancedStruct::Make<FToastieCutsceneLabel>();
+				auto BlockPtr = Struct.GetMutablePtr<FToastieCutsceneLabel>();
+				FStringView Label;
+				if (Sentence.TryGetViewAtIndex(0, Label))
+				{
+					BlockPtr->Label = FName(Label.Len(), Label.GetData());
+				}
+				AScene.Commands.Add(MoveTemp(Struct));
+			}
+
+			else
+			{
+				// Determine type of command
+				auto CommandType = TryFindCommandType(Sentence, KeywordEntry);
+				if (CommandType == nullptr)
+				{
+					UE_LOGFMT(TCSImporter, Warning, "Skipping unknown TCS Command \"{0}\" found in Line {1}", FString(Sentence.GetKeyword()), Sentence.GetLineNumber());
+					continue;
+				}
+
+				// Ensure type is valid
+				if (CommandType->IsChildOf(FToastieCutsceneCommandBase::StaticStruct()) == false)
+				{
+					UE_LOGFMT(TCSImporter, Warning, "Skipping TCS Command \"{0}\" is incorrect Type. Found in Line {1}", FString(Sentence.GetKeyword()), Sentence.GetLineNumber());
+					continue;
+				}
+
+				FInstancedStruct Struct;
+				if (DeserializeStruct(CommandType, Sentence, Struct, Defines))
+				{
+					AScene.Commands.Add(MoveTemp(Struct));
+				}
+			}
+		}
+
+		if (AScene.Commands.IsEmpty())
+		{
+			return true;
+		}
+
+		if (!TryCompileFlow(AScene))
+		{
+			return false;
+		}
+
+		// Calculate "bKeepSpeechBubbleForNextLine" for each Say command
+		for (int i = 0; i < AScene.Commands.Num() - 2; ++i)
+		{
+			auto SayCurrent = AScene.Commands[i + 0].GetMutablePtr<FToastieCutsceneSay>();
+			auto SayNext = AScene.Commands[i + 1].GetPtr<FToastieCutsceneSay>();
+			if (SayCurrent)
+			{
+				if (SayNext)
+				{
+					const auto bSameSpeaker = SayCurrent->Who == SayNext->Who;
+					const auto bSameThink = SayCurrent->bThink == SayNext->bThink;
+					SayCurrent->bKeepSpeechBubbleForNextLine = bSameSpeaker && bSameThink;
+				}
+				else
+				{
+					SayCurrent->bKeepSpeechBubbleForNextLine = false;
+				}
+			}
+		}
+		if (auto SayLast = AScene.Commands.Last().GetMutablePtr<FToastieCutsceneSay>();
+			SayLast)
+		{
+			SayLast->bKeepSpeechBubbleForNextLine = false;
+		}
+
+		return true;
+	}
+
+	bool TryParseScenes(
+		const TArray<Lexer::FSentence>& ASentences,
+		TConstArrayView<FSceneRange> ASceneRanges,
+		TArray<FScene>& AScenes)
+	{
+		AScenes.Reset();
+		AScenes.SetNum(ASceneRanges.Num());
+
+		TArray<bool> Results;
+		Results.SetNumZeroed(ASceneRanges.Num());
+
+		// Scenes only read the sentences and their own range, so each one can be parsed on its own thread
+		ParallelFor(ASceneRanges.Num(), [&](int32 Index)
+		{
+			Results[Index] = TryParseScene(ASentences, ASceneRanges[Index], AScenes[Index]);
+		}, EParallelForFlags::Unbalanced);
+
+		return !Results.Contains(false);
+	}
+
+	void ApplySceneToAsset(
+		FScene& AScene,
+		UToastieCutsceneAsset& AAsset)
+	{
+		AAsset.Commands = MoveTemp(AScene.Commands);
+		AAsset.bDialogue = AScene.bDialogue;
+		AAsset.SourceHash = AScene.SourceHash;
+		AAsset.BuildRuntimeData();
+	}
+
+	UStringTable* FindOrCreateStringTable(
+		const FString& APackagePath,
+		const FString& ASourceFilename,
+		EObjectFlags AFlags)
+	{
+		check(IsInGameThread());
+
+		// Named after the source file, so imports and reimports of it always find the same table
+		const auto TableName = ObjectTools::SanitizeObjectName(FPaths::GetBaseFilename(ASourceFilename) + TEXT("_Strings"));
+		const auto PackageName = UPackageTools::SanitizePackageName(APackagePath + TEXT("/") + TableName);
+
+		const auto ObjectPath = PackageName + TEXT(".") + TableName;
+		if (auto Existing = LoadObject<UStringTable>(nullptr, *ObjectPath, nullptr, LOAD_NoWarn | LOAD_Quiet))
+		{
+			return Existing;
+		}
+
+		auto Package = CreatePackage(*PackageName);
+		if (Package == nullptr)
+		{
+			UE_LOG(TCSImporter, Error, TEXT("Import Error: Unable to create Package for TCS String Table"));
+			return nullptr;
+		}
+
+		auto StringTable = NewObject<UStringTable>(Package, FName(TableName), AFlags);
+		if (StringTable)
+		{
+			StringTable->GetMutableStringTable()->SetNamespace(TEXT("TCS"));
+			FAssetRegistryModule::AssetCreated(StringTable);
+			StringTable->MarkPackageDirty();
+		}
+		return StringTable;
+	}
+
+	FString MakeStringTableKey(const FString& ASourceString)
+	{
+		const auto Hash = FXxHash64::HashBuffer(*ASourceString, ASourceString.Len() * sizeof(TCHAR)).Hash;
+		return FString::Printf(TEXT("%016llX"), Hash);
+	}
+
+	/// Calls AFunc with every FText of a command, const if the command's memory is
+	template<typename TMemory, typename TFunc>
+	void ForEachText(const UScriptStruct* ACommandType, TMemory* AMemory, TFunc&& AFunc)
+	{
+		if (!ACommandType)
+			return;
+
+		for (TFieldIterator<FTextProperty> It(ACommandType); It; ++It)
+		{
+			AFunc(*It->ContainerPtrToValuePtr<FText>(AMemory));
+		}
+	}
+
+	void MoveTextsToStringTable(
+		FScene& AScene,
+		UStringTable& AStringTable,
+		FStringTableStats& AStats)
+	{
+		check(IsInGameThread());
+
+		const auto TableId = AStringTable.GetStringTableId();
+		const auto Table = AStringTable.GetMutableStringTable();
+
+		for (auto& Command : AScene.Commands)
+		{
+			ForEachText(Command.GetScriptStruct(), Command.GetMutableMemory(), [&](FText& Text)
+			{
+				if (Text.IsEmpty() || Text.IsFromStringTable())
+					return;
+
+				// Keys come from the text itself, so repeated lines share an entry and keep their key across imports
+				const auto& SourceString = Text.ToString();
+				const auto Key = MakeStringTableKey(SourceString);
+
+				FString ExistingString;
+				if (Table->GetSourceString(Key, ExistingString))
+				{
+					if (!ExistingString.Equals(SourceString, ESearchCase::CaseSensitive))
+					{
+						UE_LOGFMT(TCSImporter, Warning, "String Table key {0} collides for \"{1}\" in Scene {2}, keeping the text inline", Key, SourceString, AScene.Name);
+						return;
+					}
+				}
+				else
+				{
+					Table->SetSourceString(Key, SourceString);
+				}
+
+				const auto Bytes = (SourceString.Len() + 1) * sizeof(TCHAR);
+				++AStats.NumTexts;
+				AStats.TextBytes += Bytes;
+				bool bAlreadyCounted = false;
+				AStats.Keys.Add(Key, &bAlreadyCounted);
+				if (!bAlreadyCounted)
+				{
+					AStats.UniqueTextBytes += Bytes;
+				}
+
+				Text = FText::FromStringTable(TableId, Key);
+			});
+		}
+	}
+
+	void CollectStringTableKeys(
+		TConstArrayView<FInstancedStruct> ACommands,
+		TSet<FString>& AKeys)
+	{
+		for (const auto& Command : ACommands)
+		{
+			ForEachText(Command.GetScriptStruct(), Command.GetMemory(), [&AKeys](const FText& Text)
+			{
+				FName TableId;
+				FString Key;
+				if (FTextInspector::GetTableIdAndKey(Text, TableId, Key))
+				{
+					AKeys.Add(MoveTemp(Key));
+				}
+				else if (!Text.IsEmpty())
+				{
+					AKeys.Add(MakeStringTableKey(Text.ToString()));
+				}
+			});
+		}
+	}
+
+	bool TryCollectSceneStringTableKeys(
+		const TArray<Lexer::FSentence>& ASentences,
+		TConstArrayView<FSceneRange> ASceneRanges,
+		TSet<FString>& AKeys)
+	{
+		TArray<FScene> Scenes;
+		if (!TryParseScenes(ASentences, ASceneRanges, Scenes))
+			return false;
+
+		for (const auto& Scene : Scenes)
+		{
+			CollectStringTableKeys(Scene.Commands, AKeys);
+		}
+		return true;
+	}
+
+	void RemoveUnusedStringTableEntries(
+		const TSet<FString>& AKeys,
+		const TSet<FString>& AUsedKeys,
+		UStringTable& AStringTable)
+	{
+		check(IsInGameThread());
+
+		const auto Table = AStringTable.GetMutableStringTable();
+		int32 NumRemoved = 0;
+		for (const auto& Key : AKeys)
+		{
+			if (!AUsedKeys.Contains(Key))
+			{
+				Table->RemoveSourceString(Key);
+				++NumRemoved;
+			}
+		}
+		UE_LOGFMT(TCSImporter, Log, "String Table {0}: removed {1} entries no Scene uses any more", AStringTable.GetName(), NumRemoved);
+	}
+
+	void FStringTableStats::Log(const UStringTable& AStringTable) const
+	{
+		UE_LOGFMT(TCSImporter, Log, "String Table {0}: {1} texts stored as {2} unique entries, {3} bytes of text reduced to {4}",
+			AStringTable.GetName(), NumTexts, Keys.Num(), TextBytes, UniqueTextBytes);
+	}
+
+	bool TryCreateSceneAssets(
+		TArray<FScene>& AScenes,
+		UObject* AInParent,
+		EObjectFlags AFlags,
+		TArray<UObject*>& AObjectsOutput)
+	{
+		check(IsInGameThread());
+
+		for (auto& Scene : AScenes)
+		{
+			if (Scene.Commands.IsEmpty())
+				continue;
+
+			if (AInParent == nullptr || AInParent->GetOutermost() == nullptr)
+			{
+				UE_LOG(TCSImporter, Error, TEXT("Import Error: Invalid Parent Object"));
+				return false;
+			}
+
+			auto SceneAssetName = ObjectTools::SanitizeObjectName(Scene.Name);
+
+			auto NewPackageName = FPackageName::GetLongPackagePath(AInParent->GetOutermost()->GetName()) + TEXT("/") + SceneAssetName;
+			NewPackageName = UPackageTools::SanitizePackageName(NewPackageName);
+
+			auto Package = CreatePackage(*NewPackageName);
+			if (Package == nullptr)
+			{
+				UE_LOG(TCSImporter, Error, TEXT("Import Error: Unable to create Package for TCS Asset"));
+				return false;
+			}
+
+			Package->FullyLoad();
+
+			auto SceneAsset = NewObject<UToastieCutsceneAsset>(Package, FName(SceneAssetName), AFlags);
+			if (SceneAsset)
+			{
+				ApplySceneToAsset(Scene, *SceneAsset);
+				AObjectsOutput.Add(SceneAsset);
+			}
+		}
+		return true;
+	}
+
+	bool TryParse(
+		const TArray<Lexer::FSentence>& ASentences,
+		UObject* AInParent,
+		EObjectFlags AFlags,
+		TArray<UObject*>& AObjectsOutput,
+		const FString& ASourceFilename,
+		const TArray<FString>& ASceneFilter,
+		FStringTableStats* AOutStats)
+	{
+		// The string table goes next to the Scenes, so the parent is needed before anything is created
+		if (AInParent == nullptr || AInParent->GetOutermost() == nullptr)
+		{
+			UE_LOG(TCSImporter, Error, TEXT("Import Error: Invalid Parent Object"));
+			return false;
+		}
+
+		TArray<FSceneRange> SceneRanges;
+		{
+			TOASTIECUTSCENES_SCOPE(SplitScenes);
+			if (!TrySplitScenes(ASentences, SceneRanges))
+			{
+				return false;
+			}
+		}
+
+		if (!ASceneFilter.IsEmpty())
+		{
+			SceneRanges.RemoveAll([&ASceneFilter](const FSceneRange& SceneRange)
+			{
+				return !ASceneFilter.Contains(SceneRange.Name);
+			});
+		}
+
+		TArray<FScene> Scenes;
+		{
+			TOASTIECUTSCENES_SCOPE(ParseScenes);
+			if (!TryParseScenes(ASentences, SceneRanges, Scenes))
+			{
+				return false;
+			}
+		}
+
+		// Every Scene of the file shares one string table
+		{
+			TOASTIECUTSCENES_SCOPE(StringTable);
+			const auto PackagePath = FPackageName::GetLongPackagePath(AInParent->GetOutermost()->GetName());
+			auto StringTable = FindOrCreateStringTable(PackagePath, ASourceFilename, AFlags);
+			if (StringTable == nullptr)
+			{
+				return false;
+			}
+
+			// A full import rebuilds the table, dropping lines that were removed from the file
+			if (ASceneFilter.IsEmpty())
+			{
+				StringTable->Modify();
+				StringTable->GetMutableStringTable()->ClearSourceStrings();
+			}
+
+			FStringTableStats Stats;
+			for (auto& Scene : Scenes)
+			{
+				MoveTextsToStringTable(Scene, *StringTable, Stats);
+			}
+			StringTable->MarkPackageDirty();
+			Stats.Log(*StringTable);
+			if (AOutStats)
+			{
+				*AOutStats = MoveTemp(Stats);
+			}
+		}
+
+		// Assets are only created once every Scene has parsed, in the order they appear in the file
+		TOASTIECUTSCENES_SCOPE(CreateAssets);
+		return TryCreateSceneAssets(Scenes, AInParent, AFlags, AObjectsOutput);
+	}
+}
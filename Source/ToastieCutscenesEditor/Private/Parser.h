@@ -0,0 +1,183 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Lexer.h"
+#include "StructUtils/InstancedStruct.h"
+
+class UToastieCutsceneAsset;
+class UStringTable;
+
+namespace Parser
+{
+	enum class EKeyword : uint8
+	{
+		None,
+		Command,
+		Scene,
+		EndScene,
+		Block,
+		EndBlock,
+		PlayerChoice,
+		EndPlayerChoice,
+		Define
+	};
+
+	struct FKeywordEntry
+	{
+		EKeyword Keyword = EKeyword::None;
+		const UScriptStruct* CommandType = nullptr;
+	};
+
+	/// <summary>
+	/// Maps the keyword that starts a sentence to either a structural keyword of the TCS format
+	/// or the command struct it deserializes into. Built when the editor module starts up.
+	/// Command structs are keyed by their TCS meta, Say commands and Labels are never looked up.
+	/// </summary>
+	class FKeywordTable
+	{
+	public:
+		static FKeywordTable& Get();
+
+		void Initialize();
+		void Shutdown();
+
+		bool RegisterCommandType(const UScriptStruct* CommandType);
+		void UnregisterCommandType(const UScriptStruct* CommandType);
+
+		const FKeywordEntry* Find(const Lexer::FSentence& Sentence) const;
+
+	private:
+		TMap<FName, FKeywordEntry> Entries;
+	};
+
+	/// Forgets the field offsets cached for every command struct, so structs replaced by a hot reload
+	/// or Live Coding are bound again. Must not be called while Scenes are being parsed
+	void ResetStructBindings();
+
+	struct FScene
+	{
+		FString Name;
+		TArray<FInstancedStruct> Commands;
+		bool bDialogue;
+		uint64 SourceHash;
+
+		FScene()
+			: Name()
+			, Commands()
+			, bDialogue(false)
+			, SourceHash(0)
+		{
+			Reset();
+		}
+
+		bool IsValid() const
+		{
+			return !Name.IsEmpty();
+		}
+
+		void Reset()
+		{
+			Name.Reset();
+			Commands.Reset();
+			bDialogue = false;
+			SourceHash = 0;
+		}
+	};
+
+	/// <summary>
+	/// The sentences that make up one Scene. A range starts right after the previous EndScene
+	/// and ends at its own EndScene, so stray commands before a Scene keyword are part of it.
+	/// </summary>
+	struct FSceneRange
+	{
+		FString Name;
+		bool bDialogue = false;
+		int32 FirstSentence = 0;
+		int32 EndSentence = 0;
+
+		/// Defines made before FirstSentence
+		TSharedPtr<const TMap<FString, FString>> Defines;
+
+		/// Hash of every token in the range and the Defines it starts with,
+		/// if this matches the hash stored on an asset the asset is already up to date
+		uint64 SourceHash = 0;
+	};
+
+	/// Finds every Scene in the sentences without parsing any commands
+	bool TrySplitScenes(
+		const TArray<Lexer::FSentence>& ASentences,
+		TArray<FSceneRange>& ASceneRanges);
+
+	/// Parses the commands of a single Scene, safe to call from any thread
+	bool TryParseScene(
+		const TArray<Lexer::FSentence>& ASentences,
+		const FSceneRange& ASceneRange,
+		FScene& AScene);
+
+	/// Parses every Scene in parallel, AScenes matches the order of ASceneRanges
+	bool TryParseScenes(
+		const TArray<Lexer::FSentence>& ASentences,
+		TConstArrayView<FSceneRange> ASceneRanges,
+		TArray<FScene>& AScenes);
+
+	/// Moves the parsed Scene into an asset, replacing anything the asset held before
+	void ApplySceneToAsset(
+		FScene& AScene,
+		UToastieCutsceneAsset& AAsset);
+
+	/// Counts how much text MoveTextsToStringTable deduplicated
+	struct FStringTableStats
+	{
+		int32 NumTexts = 0;
+		int64 TextBytes = 0;
+		int64 UniqueTextBytes = 0;
+		TSet<FString> Keys;
+
+		void Log(const UStringTable& AStringTable) const;
+	};
+
+	/// Finds or creates the string table shared by every Scene of the source file, named after the file. Game thread only
+	UStringTable* FindOrCreateStringTable(
+		const FString& APackagePath,
+		const FString& ASourceFilename,
+		EObjectFlags AFlags);
+
+	/// Adds every FText of the Scene's commands to the string table and points the text at its entry, game thread only
+	void MoveTextsToStringTable(
+		FScene& AScene,
+		UStringTable& AStringTable,
+		FStringTableStats& AStats);
+
+	/// Adds the string table key of every FText in ACommands to AKeys, inline texts add the key they would be stored under
+	void CollectStringTableKeys(
+		TConstArrayView<FInstancedStruct> ACommands,
+		TSet<FString>& AKeys);
+
+	/// Adds the string table key of every line the Scenes in ASceneRanges say to AKeys. Parses those Scenes to find out
+	bool TryCollectSceneStringTableKeys(
+		const TArray<Lexer::FSentence>& ASentences,
+		TConstArrayView<FSceneRange> ASceneRanges,
+		TSet<FString>& AKeys);
+
+	/// Removes the entries in AKeys that aren't in AUsedKeys, such as the old lines of a reimported Scene. Game thread only
+	void RemoveUnusedStringTableEntries(
+		const TSet<FString>& AKeys,
+		const TSet<FString>& AUsedKeys,
+		UStringTable& AStringTable);
+
+	/// Creates a package and asset for every Scene with commands, game thread only
+	bool TryCreateSceneAssets(
+		TArray<FScene>& AScenes,
+		UObject* AInParent,
+		EObjectFlags AFlags,
+		TArray<UObject*>& AObjectsOutput);
+
+	bool TryParse(
+		const TArray<Lexer::FSentence>& ASentences,
+		UObject* AInParent,
+		EObjectFlags AFlags,
+		TArray<UObject*>& AObjectsOutput,
+		const FString& ASourceFilename,
+		const TArray<FString>& ASceneFilter,
+		FStringTableStats* AOutStats = nullptr);
+}
@@ -1,6 +1,8 @@
 #include "ToastieCutscenesEditor.h"
 #include "AssetToolsModule.h"
 #include "AssetTypeActions_ToastieCutsceneAsset.h"
+#include "Parser.h"
+#include "UObject/UObjectGlobals.h"
 
 namespace
 {
@@ -9,6 +11,15 @@ namespace
 
 void FToastieCutscenesEditorModule::StartupModule()
 {
+	// Register TCS keywords and built in commands
+	Parser::FKeywordTable::Get().Initialize();
+
+	// A reload can replace command structs, the importer's cached field offsets would point into the old ones
+	ReloadCompleteHandle = FCoreUObjectDelegates::ReloadCompleteDelegate.AddLambda([](EReloadCompleteReason)
+	{
+		Parser::ResetStructBindings();
+	});
+
 	// Register asset types
 	ToastieCutsceneAssetTypeActions = MakeShareable(new FAssetTypeActions_ToastieCutsceneAsset());
 	FAssetToolsModule::GetModule().Get().RegisterAssetTypeActions(ToastieCutsceneAssetTypeActions.ToSharedRef());
@@ -22,6 +33,24 @@ void FToastieCutscenesEditorModule::ShutdownModule()
 	{
 		FAssetToolsModule::GetModule().Get().UnregisterAssetTypeActions(ToastieCutsceneAssetTypeActions.ToSharedRef());
 	}
+
+	FCoreUObjectDelegates::ReloadCompleteDelegate.Remove(ReloadCompleteHandle);
+	Parser::FKeywordTable::Get().Shutdown();
+}
+
+FToastieCutscenesEditorModule& FToastieCutscenesEditorModule::Get()
+{
+	return FModuleManager::LoadModuleChecked<FToastieCutscenesEditorModule>("ToastieCutscenesEditor");
+}
+
+bool FToastieCutscenesEditorModule::RegisterCommandType(const UScriptStruct* CommandType)
+{
+	return Parser::FKeywordTable::Get().RegisterCommandType(CommandType);
+}
+
+void FToastieCutscenesEditorModule::UnregisterCommandType(const UScriptStruct* CommandType)
+{
+	Parser::FKeywordTable::Get().UnregisterCommandType(CommandType);
 }
 	
-IMPLEMENT_MODULE(FToastieCutscenesEditorModule, ToastieCutscenes)
\ No newline at end of file
+IMPLEMENT_MODULE(FToastieCutscenesEditorModule, ToastieCutscenesEditor)
\ No newline at end of file
@@ -0,0 +1,399 @@
+#include "ToastieCutscenesImportBenchmarkCommandlet.h"
+#include "CountingMalloc.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Lexer.h"
+#include "Logging/StructuredLog.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Parser.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "UObject/Package.h"
+
+DEFINE_LOG_CATEGORY_STATIC(TCSImportBenchmark, Log, All);
+
+namespace
+{
+	struct FCorpusFile
+	{
+		FString Name;
+
+		// Sentences reference Text, it must not change once lexed
+		FString Text;
+		TArray<Lexer::FSentence> Sentences;
+		TArray<Parser::FSceneRange> SceneRanges;
+	};
+
+	struct FPhaseResult
+	{
+		FString Name;
+		double Seconds = 0.0;
+		int32 NumCountedIterations = 0;
+		int64 NumAllocations = 0;
+		int64 AllocatedBytes = 0;
+		int64 PeakBytes = 0;
+		bool bSucceeded = true;
+	};
+
+	// Runs Body once unmeasured, NumIterations times timed, then NumCountedIterations times counting allocations.
+	// Counting slows every allocation down, so it never runs while the phase is timed.
+	// Cleanup runs after each iteration, outside the measurement
+	FPhaseResult MeasurePhase(FCountingMalloc& CountingMalloc, const TCHAR* Name, const int32 NumIterations, const int32 NumCountedIterations,
+		TFunctionRef<bool()> Body, TFunctionRef<void()> Cleanup)
+	{
+		FPhaseResult Result;
+		Result.Name = Name;
+		Result.bSucceeded = Body();
+		Cleanup();
+
+		for (int32 Iteration = 0; Iteration < NumIterations && Result.bSucceeded; ++Iteration)
+		{
+			const auto StartTime = FPlatformTime::Seconds();
+			Result.bSucceeded = Body();
+			Result.Seconds += FPlatformTime::Seconds() - StartTime;
+			Cleanup();
+		}
+
+		for (int32 Iteration = 0; Iteration < NumCountedIterations && Result.bSucceeded; ++Iteration)
+		{
+			CountingMalloc.StartCounting();
+			Result.bSucceeded = Body();
+			CountingMalloc.StopCounting();
+
+			++Result.NumCountedIterations;
+			Result.NumAllocations += CountingMalloc.GetNumAllocations();
+			Result.AllocatedBytes += CountingMalloc.GetAllocatedBytes();
+			Result.PeakBytes = FMath::Max(Result.PeakBytes, CountingMalloc.GetPeakBytes());
+			Cleanup();
+		}
+		return Result;
+	}
+
+	// A Scene's worth of the commands the format supports, NumLines long at least. Lines repeat so the string table has duplicates
+	void AppendSyntheticScene(FStringBuilderBase& Builder, const FString& SceneName, const int32 NumLines)
+	{
+		Builder.Appendf(TEXT("Scene %s Dialogue\n"), *SceneName);
+		for (int32 Chunk = 0, Line = 0; Line < NumLines; ++Chunk, Line += 19)
+		{
+			Builder.Appendf(TEXT("\tSelf: \"Line %d of the synthetic corpus\"\n"), Chunk % 50);
+			Builder.Appendf(TEXT("\tPlayer: \"Reply %d\" Think\n"), Chunk % 20);
+			Builder.Append(TEXT("\tWait 0.5\n"));
+			Builder.Append(TEXT("\tBlock Concurrent\n"));
+			Builder.Append(TEXT("\t\tLookAt Self Player\n"));
+			Builder.Appendf(TEXT("\t\tSelf: \"Concurrent %d\" NoAnimation\n"), Chunk % 10);
+			Builder.Append(TEXT("\tEndBlock\n"));
+			Builder.Append(TEXT("\tPlayerChoice\n"));
+			Builder.Appendf(TEXT("\t\tOption [First%d] \"First\"\n"), Chunk);
+			Builder.Appendf(TEXT("\t\tOption [Second%d] \"Second\"\n"), Chunk);
+			Builder.Append(TEXT("\t\tOption Exit \"Leave\"\n"));
+			Builder.Append(TEXT("\tEndPlayerChoice\n"));
+			Builder.Appendf(TEXT("\t[First%d]\n"), Chunk);
+			Builder.Append(TEXT("\tPlayer: \"Took the first\"\n"));
+			Builder.Appendf(TEXT("\tGoto [Join%d]\n"), Chunk);
+			Builder.Appendf(TEXT("\t[Second%d]\n"), Chunk);
+			Builder.Append(TEXT("\tPlayer: \"Took the second\"\n"));
+			Builder.Appendf(TEXT("\t[Join%d]\n"), Chunk);
+			Builder.Append(TEXT("\t; End of chunk\n"));
+		}
+		Builder.Append(TEXT("EndScene\n\n"));
+	}
+
+	void BuildSyntheticCorpus(TArray<FCorpusFile>& Corpus, const int32 NumFiles, const int32 NumScenes, const int32 NumLines)
+	{
+		for (int32 FileIndex = 0; FileIndex < NumFiles; ++FileIndex)
+		{
+			TStringBuilder<64 * 1024> Builder;
+			for (int32 SceneIndex = 0; SceneIndex < NumScenes; ++SceneIndex)
+			{
+				AppendSyntheticScene(Builder, FString::Printf(TEXT("Synthetic_%d_%d"), FileIndex, SceneIndex), NumLines);
+			}
+
+			auto& File = Corpus.AddDefaulted_GetRef();
+			File.Name = FString::Printf(TEXT("Synthetic_%d"), FileIndex);
+			File.Text = Builder.ToString();
+		}
+	}
+
+	bool LoadCorpus(TArray<FCorpusFile>& Corpus, const FString& Directory)
+	{
+		TArray<FString> Filenames;
+		IFileManager::Get().FindFilesRecursive(Filenames, *Directory, TEXT("*.tcs"), true, false);
+		Filenames.Sort();
+
+		for (const auto& Filename : Filenames)
+		{
+			auto& File = Corpus.AddDefaulted_GetRef();
+			File.Name = FPaths::GetBaseFilename(Filename);
+			if (!FFileHelper::LoadFileToString(File.Text, *Filename))
+			{
+				UE_LOGFMT(TCSImportBenchmark, Error, "Unable to read {0}", Filename);
+				return false;
+			}
+		}
+		return !Corpus.IsEmpty();
+	}
+
+	// Parses the Scenes one after another on this thread, as import did before Scenes were parsed in parallel
+	bool TryParseScenesSerial(const FCorpusFile& File, TArray<Parser::FScene>& Scenes)
+	{
+		Scenes.Reset();
+		Scenes.SetNum(File.SceneRanges.Num());
+		for (int32 Index = 0; Index < File.SceneRanges.Num(); ++Index)
+		{
+			if (!Parser::TryParseScene(File.Sentences, File.SceneRanges[Index], Scenes[Index]))
+				return false;
+		}
+		return true;
+	}
+
+	// Parallel parsing must give exactly what parsing the Scenes in order does
+	bool MatchesSerialParse(const FCorpusFile& File)
+	{
+		TArray<Parser::FScene> SerialScenes;
+		TArray<Parser::FScene> ParallelScenes;
+		if (!TryParseScenesSerial(File, SerialScenes) || !Parser::TryParseScenes(File.Sentences, File.SceneRanges, ParallelScenes))
+			return false;
+
+		for (int32 Index = 0; Index < SerialScenes.Num(); ++Index)
+		{
+			const auto& Serial = SerialScenes[Index];
+			const auto& Parallel = ParallelScenes[Index];
+			if (Serial.Name != Parallel.Name || Serial.bDialogue != Parallel.bDialogue || Serial.SourceHash != Parallel.SourceHash
+				|| Serial.Commands.Num() != Parallel.Commands.Num())
+			{
+				return false;
+			}
+			for (int32 CommandIndex = 0; CommandIndex < Serial.Commands.Num(); ++CommandIndex)
+			{
+				if (!Serial.Commands[CommandIndex].Identical(&Parallel.Commands[CommandIndex], PPF_None))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	TSharedRef<FJsonObject> PhaseToJson(const FPhaseResult& Phase, const int32 NumIterations, const int64 NumTokens, const int64 NumSentences)
+	{
+		const auto Seconds = FMath::Max(Phase.Seconds, UE_SMALL_NUMBER);
+		auto Json = MakeShared<FJsonObject>();
+		Json->SetStringField(TEXT("name"), Phase.Name);
+		Json->SetBoolField(TEXT("succeeded"), Phase.bSucceeded);
+		Json->SetNumberField(TEXT("secondsPerIteration"), Phase.Seconds / NumIterations);
+		Json->SetNumberField(TEXT("tokensPerSecond"), NumTokens * NumIterations / Seconds);
+		Json->SetNumberField(TEXT("sentencesPerSecond"), NumSentences * NumIterations / Seconds);
+		const auto NumCounted = FMath::Max(Phase.NumCountedIterations, 1);
+		Json->SetNumberField(TEXT("allocationsPerIteration"), static_cast<double>(Phase.NumAllocations) / NumCounted);
+		Json->SetNumberField(TEXT("allocatedBytesPerIteration"), static_cast<double>(Phase.AllocatedBytes) / NumCounted);
+		Json->SetNumberField(TEXT("peakBytes"), static_cast<double>(Phase.PeakBytes));
+		return Json;
+	}
+}
+
+UToastieCutscenesImportBenchmarkCommandlet::UToastieCutscenesImportBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UToastieCutscenesImportBenchmarkCommandlet::Main(const FString& Params)
+{
+	// Swapped in before any phase starts worker threads, so no allocation ever sees GMalloc change under it
+	auto& CountingMalloc = FCountingMalloc::Install();
+
+	int32 NumIterations = 10;
+	FParse::Value(*Params, TEXT("Iterations="), NumIterations);
+	NumIterations = FMath::Max(NumIterations, 1);
+
+	int32 NumCountedIterations = 1;
+	FParse::Value(*Params, TEXT("AllocIterations="), NumCountedIterations);
+	NumCountedIterations = FMath::Max(NumCountedIterations, 1);
+
+	TArray<FCorpusFile> Corpus;
+	FString Directory;
+	const auto bSynthetic = !FParse::Value(*Params, TEXT("Dir="), Directory);
+	if (bSynthetic)
+	{
+		int32 NumFiles = 1;
+		int32 NumScenes = 500;
+		int32 NumLines = 200;
+		FParse::Value(*Params, TEXT("Files="), NumFiles);
+		FParse::Value(*Params, TEXT("Scenes="), NumScenes);
+		FParse::Value(*Params, TEXT("Lines="), NumLines);
+		BuildSyntheticCorpus(Corpus, FMath::Max(NumFiles, 1), FMath::Max(NumScenes, 1), FMath::Max(NumLines, 1));
+	}
+	else if (!LoadCorpus(Corpus, Directory))
+	{
+		UE_LOGFMT(TCSImportBenchmark, Error, "No .tcs files could be read from {0}", Directory);
+		return 1;
+	}
+
+	// Later phases start from the output of the earlier ones, which is built once here
+	int64 NumBytes = 0;
+	int64 NumTokens = 0;
+	int64 NumSentences = 0;
+	int64 NumScenes = 0;
+	for (auto& File : Corpus)
+	{
+		if (!Lexer::TryTokenize(File.Text, File.Sentences) || !Parser::TrySplitScenes(File.Sentences, File.SceneRanges))
+		{
+			UE_LOGFMT(TCSImportBenchmark, Error, "{0} doesn't import", File.Name);
+			return 1;
+		}
+		if (!MatchesSerialParse(File))
+		{
+			UE_LOGFMT(TCSImportBenchmark, Error, "{0} parses differently in parallel", File.Name);
+			return 1;
+		}
+
+		NumBytes += File.Text.Len() * sizeof(TCHAR);
+		NumScenes += File.SceneRanges.Num();
+		for (const auto& Sentence : File.Sentences)
+		{
+			if (Sentence.IsValid())
+			{
+				NumTokens += Sentence.GetTokens().Num();
+				++NumSentences;
+			}
+		}
+	}
+
+	const auto NoCleanup = []() {};
+	TArray<FPhaseResult> Phases;
+
+	Phases.Add(MeasurePhase(CountingMalloc, TEXT("lex"), NumIterations, NumCountedIterations, [&Corpus]()
+	{
+		TArray<Lexer::FSentence> Sentences;
+		for (const auto& File : Corpus)
+		{
+			if (!Lexer::TryTokenize(File.Text, Sentences))
+				return false;
+		}
+		return true;
+	}, NoCleanup));
+
+	Phases.Add(MeasurePhase(CountingMalloc, TEXT("splitScenes"), NumIterations, NumCountedIterations, [&Corpus]()
+	{
+		TArray<Parser::FSceneRange> SceneRanges;
+		for (const auto& File : Corpus)
+		{
+			if (!Parser::TrySplitScenes(File.Sentences, SceneRanges))
+				return false;
+		}
+		return true;
+	}, NoCleanup));
+
+	Phases.Add(MeasurePhase(CountingMalloc, TEXT("parseScenesSerial"), NumIterations, NumCountedIterations, [&Corpus]()
+	{
+		TArray<Parser::FScene> Scenes;
+		for (const auto& File : Corpus)
+		{
+			if (!TryParseScenesSerial(File, Scenes))
+				return false;
+		}
+		return true;
+	}, NoCleanup));
+
+	Phases.Add(MeasurePhase(CountingMalloc, TEXT("parseScenes"), NumIterations, NumCountedIterations, [&Corpus]()
+	{
+		TArray<Parser::FScene> Scenes;
+		for (const auto& File : Corpus)
+		{
+			if (!Parser::TryParseScenes(File.Sentences, File.SceneRanges, Scenes))
+				return false;
+		}
+		return true;
+	}, NoCleanup));
+
+	// Assets go to a transient package and are collected between iterations, nothing is saved
+	Phases.Add(MeasurePhase(CountingMalloc, TEXT("import"), NumIterations, NumCountedIterations, [&Corpus]()
+	{
+		for (const auto& File : Corpus)
+		{
+			const auto Parent = CreatePackage(*(TEXT("/Temp/ToastieCutscenesImportBenchmark/") + File.Name));
+			TArray<UObject*> Objects;
+			if (!Parser::TryParse(File.Sentences, Parent, RF_Public | RF_Transient, Objects, File.Name, TArray<FString>()))
+				return false;
+		}
+		return true;
+	}, []()
+	{
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+	}));
+
+	// What the string table saves over every Scene keeping its lines inline, measured on one more import of the corpus
+	int64 NumTexts = 0;
+	int64 NumEntries = 0;
+	int64 InlineTextBytes = 0;
+	int64 TableTextBytes = 0;
+	int64 TableKeyBytes = 0;
+	for (const auto& File : Corpus)
+	{
+		const auto Parent = CreatePackage(*(TEXT("/Temp/ToastieCutscenesImportBenchmark/") + File.Name));
+		TArray<UObject*> Objects;
+		Parser::FStringTableStats Stats;
+		if (Parser::TryParse(File.Sentences, Parent, RF_Public | RF_Transient, Objects, File.Name, TArray<FString>(), &Stats))
+		{
+			NumTexts += Stats.NumTexts;
+			NumEntries += Stats.Keys.Num();
+			InlineTextBytes += Stats.TextBytes;
+			TableTextBytes += Stats.UniqueTextBytes;
+			for (const auto& Key : Stats.Keys)
+			{
+				TableKeyBytes += (Key.Len() + 1) * sizeof(TCHAR);
+			}
+		}
+	}
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+
+	auto Json = MakeShared<FJsonObject>();
+	Json->SetNumberField(TEXT("iterations"), NumIterations);
+	Json->SetNumberField(TEXT("allocIterations"), NumCountedIterations);
+
+	auto CorpusJson = MakeShared<FJsonObject>();
+	CorpusJson->SetStringField(TEXT("source"), bSynthetic ? TEXT("synthetic") : *Directory);
+	CorpusJson->SetNumberField(TEXT("files"), Corpus.Num());
+	CorpusJson->SetNumberField(TEXT("bytes"), static_cast<double>(NumBytes));
+	CorpusJson->SetNumberField(TEXT("scenes"), static_cast<double>(NumScenes));
+	CorpusJson->SetNumberField(TEXT("sentences"), static_cast<double>(NumSentences));
+	CorpusJson->SetNumberField(TEXT("tokens"), static_cast<double>(NumTokens));
+	Json->SetObjectField(TEXT("corpus"), CorpusJson);
+
+	// Before: every Scene holds its own copy of each line. After: the table holds each line once, under its key
+	auto StringTableJson = MakeShared<FJsonObject>();
+	StringTableJson->SetNumberField(TEXT("texts"), static_cast<double>(NumTexts));
+	StringTableJson->SetNumberField(TEXT("entries"), static_cast<double>(NumEntries));
+	StringTableJson->SetNumberField(TEXT("bytesBefore"), static_cast<double>(InlineTextBytes));
+	StringTableJson->SetNumberField(TEXT("bytesAfter"), static_cast<double>(TableTextBytes + TableKeyBytes));
+	StringTableJson->SetNumberField(TEXT("textBytesAfter"), static_cast<double>(TableTextBytes));
+	StringTableJson->SetNumberField(TEXT("keyBytesAfter"), static_cast<double>(TableKeyBytes));
+	Json->SetObjectField(TEXT("stringTable"), StringTableJson);
+
+	TArray<TSharedPtr<FJsonValue>> PhasesJson;
+	bool bSucceeded = true;
+	for (const auto& Phase : Phases)
+	{
+		PhasesJson.Add(MakeShared<FJsonValueObject>(PhaseToJson(Phase, NumIterations, NumTokens, NumSentences)));
+		bSucceeded &= Phase.bSucceeded;
+	}
+	Json->SetArrayField(TEXT("phases"), PhasesJson);
+
+	FString Output;
+	const auto Writer = TJsonWriterFactory<>::Create(&Output);
+	FJsonSerializer::Serialize(Json, Writer);
+
+	FString OutputFilename;
+	if (FParse::Value(*Params, TEXT("Output="), OutputFilename))
+	{
+		if (!FFileHelper::SaveStringToFile(Output, *OutputFilename))
+		{
+			UE_LOGFMT(TCSImportBenchmark, Error, "Unable to write {0}", OutputFilename);
+			return 1;
+		}
+	}
+	UE_LOGFMT(TCSImportBenchmark, Display, "{0}", Output);
+
+	return bSucceeded ? 0 : 1;
+}
@@ -0,0 +1,206 @@
+#include "ToastieCutscenesLexerCommandlet.h"
+#include "HAL/FileManager.h"
+#include "Lexer.h"
+#include "Logging/StructuredLog.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_LOG_CATEGORY_STATIC(TCSLexer, Log, All);
+
+namespace
+{
+	struct FLexerCase
+	{
+		FString Name;
+		FString Text;
+	};
+
+	void AddCase(TArray<FLexerCase>& Cases, const TCHAR* Name, FString Text)
+	{
+		Cases.Add({ Name, MoveTemp(Text) });
+	}
+
+	// Every input either lexer could disagree on. Some are meant to fail, both must fail on them
+	void BuildBuiltInCorpus(TArray<FLexerCase>& Cases)
+	{
+		// Quotes
+		AddCase(Cases, TEXT("String"), TEXT("Self: \"Hello there\"\n"));
+		AddCase(Cases, TEXT("EmptyString"), TEXT("Self: \"\"\n"));
+		AddCase(Cases, TEXT("TwoStrings"), TEXT("Option [A] \"First\" Requires \"Second\"\n"));
+		AddCase(Cases, TEXT("QuoteInString"), TEXT("Self: \"She said \"hi\" twice\"\n"));
+		AddCase(Cases, TEXT("StringWithComment"), TEXT("Self: \"Not ; a comment\" ; a comment \"quoted\"\n"));
+		AddCase(Cases, TEXT("UnterminatedString"), TEXT("Self: \"Never closed\n"));
+		AddCase(Cases, TEXT("LoneQuote"), TEXT("\"\n"));
+		AddCase(Cases, TEXT("StringAcrossLines"), TEXT("Self: \"First\nSecond\"\n"));
+		AddCase(Cases, TEXT("StringWithTabs"), TEXT("Self: \"\tTabbed\t\"\n"));
+
+		// Numbers
+		AddCase(Cases, TEXT("Integer"), TEXT("Wait 1\n"));
+		AddCase(Cases, TEXT("Fraction"), TEXT("Wait 1.5\n"));
+		AddCase(Cases, TEXT("TrailingDot"), TEXT("Wait 1.\n"));
+		AddCase(Cases, TEXT("LeadingDot"), TEXT("Wait .5\n"));
+		AddCase(Cases, TEXT("TwoDots"), TEXT("Wait 1.5.2\n"));
+		AddCase(Cases, TEXT("LoneDot"), TEXT("Wait .\n"));
+		AddCase(Cases, TEXT("NumberThenIdentifier"), TEXT("Wait 10s 2_b 3-c\n"));
+		AddCase(Cases, TEXT("NumberSay"), TEXT("1: \"Numbered speaker\"\n"));
+		AddCase(Cases, TEXT("FractionSay"), TEXT("1.5: \"Not a speaker\"\n"));
+
+		// Comments
+		AddCase(Cases, TEXT("Comment"), TEXT("; A comment\n"));
+		AddCase(Cases, TEXT("EmptyComment"), TEXT(";\n"));
+		AddCase(Cases, TEXT("TrailingComment"), TEXT("Wait 1 ; after a command\n"));
+		AddCase(Cases, TEXT("CommentWithoutSpace"), TEXT("Wait 1;after\n"));
+		AddCase(Cases, TEXT("IndentedComment"), TEXT("\t\t; Indented\n"));
+
+		// Identifiers, labels and speakers
+		AddCase(Cases, TEXT("Label"), TEXT("[Start]\nGoto [Start]\n"));
+		AddCase(Cases, TEXT("LabelCharacters"), TEXT("[a-b/c_1]\n"));
+		AddCase(Cases, TEXT("EmptyLabel"), TEXT("[]\n"));
+		AddCase(Cases, TEXT("LabelWithSpace"), TEXT("[Two words]\n"));
+		AddCase(Cases, TEXT("UnclosedLabel"), TEXT("[Open\n"));
+		AddCase(Cases, TEXT("SayPath"), TEXT("Npc/Guard-2: \"Halt\"\n"));
+		AddCase(Cases, TEXT("SayWithoutText"), TEXT("Self:\n"));
+		AddCase(Cases, TEXT("DoubleColon"), TEXT("Self:: \"Twice\"\n"));
+		AddCase(Cases, TEXT("LoneColon"), TEXT(": \"Nobody\"\n"));
+		AddCase(Cases, TEXT("UnknownCharacter"), TEXT("Wait 1 + 2\n"));
+
+		// Line ends
+		AddCase(Cases, TEXT("CRLF"), TEXT("Scene Intro\r\n\tSelf: \"Hi\"\r\nEndScene\r\n"));
+		AddCase(Cases, TEXT("CR"), TEXT("Scene Intro\r\tSelf: \"Hi\"\rEndScene\r"));
+		AddCase(Cases, TEXT("MixedLineEnds"), TEXT("Scene Intro\r\n\tWait 1\n\tWait 2\r\r\nEndScene\n\r"));
+		AddCase(Cases, TEXT("CRBeforeCRLF"), TEXT("Wait 1\r\r\nWait 2\r\n"));
+		AddCase(Cases, TEXT("StringBeforeCRLF"), TEXT("Self: \"Hi\"\r\n"));
+		AddCase(Cases, TEXT("CommentBeforeCRLF"), TEXT("; Comment\r\nWait 1\r\n"));
+		AddCase(Cases, TEXT("NoFinalLineEnd"), TEXT("Wait 1\nWait 2"));
+		AddCase(Cases, TEXT("BlankLines"), TEXT("\n\n\t\n  \nWait 1\n\n"));
+		AddCase(Cases, TEXT("Empty"), TEXT(""));
+		AddCase(Cases, TEXT("VerticalTab"), TEXT("Self: \"Split\vhere\"\n"));
+		AddCase(Cases, TEXT("FormFeed"), TEXT("; Split\fhere\n"));
+		AddCase(Cases, TEXT("NextLine"), FString::Printf(TEXT("Self: \"Split%chere\"\n"), TCHAR(0x0085)));
+		AddCase(Cases, TEXT("LineSeparator"), FString::Printf(TEXT("Self: \"Split%chere\" \"After\"\n"), TCHAR(0x2028)));
+		AddCase(Cases, TEXT("ParagraphSeparator"), FString::Printf(TEXT("; Split%chere\n"), TCHAR(0x2029)));
+		AddCase(Cases, TEXT("BareLineSeparator"), FString::Printf(TEXT("Wait 1%cWait 2\n"), TCHAR(0x2028)));
+
+		// Other Unicode
+		AddCase(Cases, TEXT("UnicodeString"), FString::Printf(TEXT("Self: \"Caf%c %c\"\n"), TCHAR(0x00E9), TCHAR(0x3042)));
+		AddCase(Cases, TEXT("UnicodeComment"), FString::Printf(TEXT("; %c%c\n"), TCHAR(0x00FC), TCHAR(0x4E2D)));
+		AddCase(Cases, TEXT("UnicodeIdentifier"), FString::Printf(TEXT("Caf%c: \"Hi\"\n"), TCHAR(0x00E9)));
+		AddCase(Cases, TEXT("NonBreakingSpace"), FString::Printf(TEXT("Wait%c1\n"), TCHAR(0x00A0)));
+		AddCase(Cases, TEXT("ByteOrderMark"), FString::Printf(TEXT("%cWait 1\n"), TCHAR(0xFEFF)));
+
+		// A Scene using every command
+		AddCase(Cases, TEXT("Scene"), TEXT(
+			"; Example\n"
+			"Scene Intro Dialogue\n"
+			"\tSelf: \"Hello\" Think\n"
+			"\tWait 0.5\n"
+			"\tBlock Concurrent\n"
+			"\t\tLookAt Self Player\n"
+			"\t\tPlayer: \"Hi\" NoAnimation\n"
+			"\tEndBlock\n"
+			"\tPlayerChoice\n"
+			"\t\tOption [First] \"First\" Requires HasKey 1\n"
+			"\t\tOption Exit \"Leave\"\n"
+			"\tEndPlayerChoice\n"
+			"\t[First]\n"
+			"\tGoto [First]\n"
+			"EndScene\n"));
+	}
+
+	bool LoadCorpus(TArray<FLexerCase>& Cases, const FString& Directory)
+	{
+		TArray<FString> Filenames;
+		IFileManager::Get().FindFilesRecursive(Filenames, *Directory, TEXT("*.tcs"), true, false);
+		Filenames.Sort();
+
+		for (const auto& Filename : Filenames)
+		{
+			auto& Case = Cases.AddDefaulted_GetRef();
+			Case.Name = FPaths::GetBaseFilename(Filename);
+			if (!FFileHelper::LoadFileToString(Case.Text, *Filename))
+			{
+				UE_LOGFMT(TCSLexer, Error, "Unable to read {0}", Filename);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	FString DescribeToken(const Lexer::FToken& Token)
+	{
+		return FString::Printf(TEXT("%s '%s' at %d:%d"), Lexer::GetTokenTypeName(Token.Type), *FString(Token.Value).ReplaceCharWithEscapedChar(), Token.LineNumber, Token.ColumnNumber);
+	}
+
+	// Describes the first difference between the two results, empty if they match.
+	// Both lex the same buffer, so matching tokens view the same characters
+	FString FindDifference(const bool bScanned, TConstArrayView<Lexer::FSentence> Scanned, const bool bRegex, TConstArrayView<Lexer::FSentence> Regex)
+	{
+		if (bScanned != bRegex)
+			return FString::Printf(TEXT("scanner %s, regex %s"), bScanned ? TEXT("succeeded") : TEXT("failed"), bRegex ? TEXT("succeeded") : TEXT("failed"));
+
+		if (Scanned.Num() != Regex.Num())
+			return FString::Printf(TEXT("scanner made %d sentences, regex %d"), Scanned.Num(), Regex.Num());
+
+		for (int32 SentenceIndex = 0; SentenceIndex < Scanned.Num(); ++SentenceIndex)
+		{
+			const auto ScannedTokens = Scanned[SentenceIndex].GetTokens();
+			const auto RegexTokens = Regex[SentenceIndex].GetTokens();
+			for (int32 TokenIndex = 0; TokenIndex < FMath::Max(ScannedTokens.Num(), RegexTokens.Num()); ++TokenIndex)
+			{
+				if (!ScannedTokens.IsValidIndex(TokenIndex) || !RegexTokens.IsValidIndex(TokenIndex))
+				{
+					return FString::Printf(TEXT("sentence %d has %d tokens from the scanner, %d from regex"),
+						SentenceIndex, ScannedTokens.Num(), RegexTokens.Num());
+				}
+
+				const auto& ScannedToken = ScannedTokens[TokenIndex];
+				const auto& RegexToken = RegexTokens[TokenIndex];
+				if (ScannedToken.Type != RegexToken.Type
+					|| ScannedToken.Value.GetData() != RegexToken.Value.GetData()
+					|| ScannedToken.Value.Len() != RegexToken.Value.Len()
+					|| ScannedToken.LineNumber != RegexToken.LineNumber
+					|| ScannedToken.ColumnNumber != RegexToken.ColumnNumber)
+				{
+					return FString::Printf(TEXT("sentence %d token %d: scanner %s, regex %s"),
+						SentenceIndex, TokenIndex, *DescribeToken(ScannedToken), *DescribeToken(RegexToken));
+				}
+			}
+		}
+		return FString();
+	}
+}
+
+UToastieCutscenesLexerCommandlet::UToastieCutscenesLexerCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UToastieCutscenesLexerCommandlet::Main(const FString& Params)
+{
+	TArray<FLexerCase> Cases;
+	BuildBuiltInCorpus(Cases);
+
+	FString Directory;
+	if (FParse::Value(*Params, TEXT("Dir="), Directory) && !LoadCorpus(Cases, Directory))
+		return 1;
+
+	int32 NumDifferences = 0;
+	TArray<Lexer::FSentence> Scanned;
+	TArray<Lexer::FSentence> Regex;
+	for (const auto& Case : Cases)
+	{
+		const auto bScanned = Lexer::TryTokenize(Case.Text, Scanned);
+		const auto bRegex = Lexer::TryTokenizeRegex(Case.Text, Regex);
+		if (const auto Difference = FindDifference(bScanned, Scanned, bRegex, Regex); !Difference.IsEmpty())
+		{
+			UE_LOGFMT(TCSLexer, Error, "{0}: {1}", Case.Name, Difference);
+			++NumDifferences;
+		}
+	}
+
+	UE_LOGFMT(TCSLexer, Display, "{0} of {1} inputs lexed the same", Cases.Num() - NumDifferences, Cases.Num());
+	return NumDifferences > 0 ? 1 : 0;
+}
@@ -0,0 +1,616 @@
+#include "ToastieCutscenesSimulationCommandlet.h"
+#include "CountingMalloc.h"
+#include "CutscenePlayer.h"
+#include "CutsceneSimulator.h"
+#include "ToastieCutsceneAsset.h"
+#include "ToastieCutsceneSubsystem.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Logging/StructuredLog.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/ObjectAndNameAsStringProxyArchive.h"
+#include "UObject/Package.h"
+
+DEFINE_LOG_CATEGORY_STATIC(TCSSimulation, Log, All);
+
+namespace
+{
+	template<typename T>
+	T& AddCommand(TArray<FInstancedStruct>& Commands)
+	{
+		auto& Command = Commands.AddDefaulted_GetRef();
+		Command.InitializeAs<T>();
+		return Command.GetMutable<T>();
+	}
+
+	// CommandCount is filled in by EndBlock once the Block's commands have been added
+	int32 BeginBlock(TArray<FInstancedStruct>& Commands, const EToastieCutsceneBlockType Type)
+	{
+		const auto BlockIndex = Commands.Num();
+		AddCommand<FToastieCutsceneBlock>(Commands).Type = Type;
+		return BlockIndex;
+	}
+
+	void EndBlock(TArray<FInstancedStruct>& Commands, const int32 BlockIndex)
+	{
+		Commands[BlockIndex].GetMutable<FToastieCutsceneBlock>().CommandCount = Commands.Num() - BlockIndex - 1;
+	}
+
+	void AddSay(TArray<FInstancedStruct>& Commands, const FName Who)
+	{
+		auto& Say = AddCommand<FToastieCutsceneSay>(Commands);
+		Say.Who = Who;
+		Say.Line = FText::FromString(TEXT("Benchmark line"));
+	}
+
+	void AddLabel(TArray<FInstancedStruct>& Commands, const FName Label)
+	{
+		AddCommand<FToastieCutsceneLabel>(Commands).Label = Label;
+	}
+
+	// A Sequential Block per level, each saying a line before the next level and waiting after it
+	void BuildDeepScene(TArray<FInstancedStruct>& Commands, const int32 Depth)
+	{
+		TArray<int32> Blocks;
+		for (int32 Level = 0; Level < Depth; ++Level)
+		{
+			Blocks.Add(BeginBlock(Commands, EToastieCutsceneBlockType::Sequential));
+			AddSay(Commands, TEXT("Deep"));
+		}
+		for (int32 Level = Depth - 1; Level >= 0; --Level)
+		{
+			AddCommand<FToastieCutsceneWait>(Commands).Time = 0.05;
+			EndBlock(Commands, Blocks[Level]);
+		}
+	}
+
+	// One Concurrent Block of Width conversations, each a Sequential Block running alongside the others
+	void BuildWideScene(TArray<FInstancedStruct>& Commands, const int32 Width)
+	{
+		const auto Concurrent = BeginBlock(Commands, EToastieCutsceneBlockType::Concurrent);
+		for (int32 Conversation = 0; Conversation < Width; ++Conversation)
+		{
+			const auto Block = BeginBlock(Commands, EToastieCutsceneBlockType::Sequential);
+			AddSay(Commands, TEXT("Left"));
+			AddCommand<FToastieCutsceneLookAt>(Commands).Who = TEXT("Right");
+			AddSay(Commands, TEXT("Right"));
+			AddCommand<FToastieCutsceneWait>(Commands).Time = 0.05;
+			EndBlock(Commands, Block);
+		}
+		EndBlock(Commands, Concurrent);
+	}
+
+	// A chain of PlayerChoices. Every Option jumps to its own branch, and every branch rejoins at the next choice.
+	// Odd Options require a value the simulation doesn't have, so they're evaluated but never visible
+	void BuildBranchingScene(TArray<FInstancedStruct>& Commands, const int32 NumChoices, const int32 NumOptions)
+	{
+		for (int32 Choice = 0; Choice < NumChoices; ++Choice)
+		{
+			const auto Block = BeginBlock(Commands, EToastieCutsceneBlockType::PlayerChoice);
+			for (int32 OptionIndex = 0; OptionIndex < NumOptions; ++OptionIndex)
+			{
+				auto& Option = AddCommand<FToastieCutsceneOption>(Commands);
+				Option.Label = FName(TEXT("Branch"), Choice * NumOptions + OptionIndex + 1);
+				Option.DisplayText = FText::FromString(TEXT("Benchmark option"));
+				if (OptionIndex % 2 == 1)
+				{
+					auto& Req = Option.Requirements.AddDefaulted_GetRef();
+					Req.Key = TEXT("Unlocked");
+					Req.Op = EToastieCutsceneOperator::GreaterThan;
+					Req.Value = 0;
+				}
+			}
+			EndBlock(Commands, Block);
+
+			const auto Rejoin = FName(TEXT("Rejoin"), Choice + 1);
+			for (int32 OptionIndex = 0; OptionIndex < NumOptions; ++OptionIndex)
+			{
+				AddLabel(Commands, FName(TEXT("Branch"), Choice * NumOptions + OptionIndex + 1));
+				AddSay(Commands, TEXT("Branch"));
+				AddCommand<FToastieCutsceneGoto>(Commands).Label = Rejoin;
+			}
+			AddLabel(Commands, Rejoin);
+		}
+	}
+
+	// Every command starts in the order it's listed, each Block waiting for the one it contains
+	void BuildNestedSequentialScene(TArray<FInstancedStruct>& Commands)
+	{
+		const auto Outer = BeginBlock(Commands, EToastieCutsceneBlockType::Sequential);		// 0
+		AddSay(Commands, TEXT("Outer"));													// 1
+		const auto Inner = BeginBlock(Commands, EToastieCutsceneBlockType::Sequential);		// 2
+		AddSay(Commands, TEXT("Inner"));													// 3
+		AddCommand<FToastieCutsceneWait>(Commands).Time = 0.5;								// 4
+		EndBlock(Commands, Inner);
+		AddSay(Commands, TEXT("Outer"));													// 5
+		EndBlock(Commands, Outer);
+		AddSay(Commands, TEXT("After"));													// 6
+	}
+
+	// Two Sequential Blocks run side by side in a Concurrent one. The short Wait lets the second overtake the first
+	void BuildNestedConcurrentScene(TArray<FInstancedStruct>& Commands)
+	{
+		const auto Concurrent = BeginBlock(Commands, EToastieCutsceneBlockType::Concurrent);	// 0
+		const auto First = BeginBlock(Commands, EToastieCutsceneBlockType::Sequential);		// 1
+		AddSay(Commands, TEXT("First"));													// 2
+		AddSay(Commands, TEXT("First"));													// 3
+		EndBlock(Commands, First);
+		const auto Second = BeginBlock(Commands, EToastieCutsceneBlockType::Sequential);	// 4
+		AddCommand<FToastieCutsceneWait>(Commands).Time = 0.5;								// 5
+		AddSay(Commands, TEXT("Second"));													// 6
+		EndBlock(Commands, Second);
+		EndBlock(Commands, Concurrent);
+		AddSay(Commands, TEXT("After"));													// 7
+	}
+
+	// A Concurrent Block's own Say waits for the Block beside it, and must start in the tick that Block finishes
+	void BuildHeldBackScene(TArray<FInstancedStruct>& Commands)
+	{
+		const auto Concurrent = BeginBlock(Commands, EToastieCutsceneBlockType::Concurrent);
+		const auto Block = BeginBlock(Commands, EToastieCutsceneBlockType::Sequential);
+		AddCommand<FToastieCutsceneWait>(Commands).Time = 0.5;
+		EndBlock(Commands, Block);
+		AddSay(Commands, TEXT("HeldBack"));
+		EndBlock(Commands, Concurrent);
+	}
+
+	// Lasts exactly as long as BuildHeldBackScene when its Say starts without a tick in between
+	void BuildHeldBackReferenceScene(TArray<FInstancedStruct>& Commands, const double SayDuration)
+	{
+		const auto Concurrent = BeginBlock(Commands, EToastieCutsceneBlockType::Concurrent);
+		const auto Block = BeginBlock(Commands, EToastieCutsceneBlockType::Sequential);
+		AddCommand<FToastieCutsceneWait>(Commands).Time = 0.5 + SayDuration;
+		EndBlock(Commands, Block);
+		EndBlock(Commands, Concurrent);
+	}
+
+	// An ambient bark that loops forever. Blueprint events a plain CutscenePlayer doesn't implement finish at once,
+	// so the run alternates between executing commands and sleeping through the Delay
+	void BuildBarkScene(TArray<FInstancedStruct>& Commands, const double Delay)
+	{
+		AddLabel(Commands, TEXT("Bark"));
+		AddSay(Commands, TEXT("Npc"));
+		Commands.Last().GetMutable<FToastieCutsceneSay>().Delay = Delay;
+		const auto Concurrent = BeginBlock(Commands, EToastieCutsceneBlockType::Concurrent);
+		AddCommand<FToastieCutsceneLookAt>(Commands).Who = TEXT("Player");
+		AddSay(Commands, TEXT("Npc"));
+		EndBlock(Commands, Concurrent);
+		AddCommand<FToastieCutsceneGoto>(Commands).Label = TEXT("Bark");
+	}
+
+	UToastieCutsceneAsset* CreateSyntheticScene(const TCHAR* Name, TFunctionRef<void(TArray<FInstancedStruct>&)> Build)
+	{
+		auto Scene = NewObject<UToastieCutsceneAsset>(GetTransientPackage(), Name);
+		Build(Scene->Commands);
+		Scene->BuildRuntimeData();
+		return Scene;
+	}
+
+	SIZE_T GetSceneSize(const UToastieCutsceneAsset& Scene)
+	{
+		auto Size = Scene.Commands.GetAllocatedSize() + Scene.Opcodes.GetAllocatedSize() + Scene.LabelIndices.GetAllocatedSize();
+		for (const auto& Command : Scene.Commands)
+		{
+			if (const auto CommandType = Command.GetScriptStruct())
+			{
+				Size += CommandType->GetStructureSize();
+			}
+		}
+		return Size;
+	}
+
+	// Commands as tagged property serialization writes them: each one with its struct and property tags
+	void SerializeTaggedCommands(FArchive& Ar, TArray<FInstancedStruct>& Commands)
+	{
+		int32 NumCommands = Commands.Num();
+		Ar << NumCommands;
+		if (Ar.IsLoading())
+		{
+			Commands.Reset(NumCommands);
+			Commands.SetNum(NumCommands);
+		}
+		for (auto& Command : Commands)
+		{
+			Command.Serialize(Ar);
+		}
+	}
+
+	// Finishes every command from inside StartCommand, then reports it as still running,
+	// like a Blueprint event that calls Finish Command before returning In Progress
+	class FSynchronousFinishExecutor final : public ICutsceneCommandExecutor
+	{
+	public:
+		explicit FSynchronousFinishExecutor(FCutsceneProcessPool& InProcessPool)
+			: ProcessPool(InProcessPool)
+		{
+		}
+
+		virtual bool CheckRequirements(const TArray<FToastieCutsceneReq>& Reqs) override
+		{
+			return Reqs.IsEmpty();
+		}
+
+		virtual bool StartCommand(const int32 Index, const int32 Id) override
+		{
+			ProcessPool.FinishCommand(Id);
+			return false;
+		}
+
+	private:
+		FCutsceneProcessPool& ProcessPool;
+	};
+
+	// Plays Scene with FSynchronousFinishExecutor, it must run to the end rather than wait on commands that already finished
+	bool CheckSynchronousFinish(const UToastieCutsceneAsset& Scene)
+	{
+		FCutsceneProcessPool ProcessPool;
+		FSynchronousFinishExecutor Executor(ProcessPool);
+		ProcessPool.Start(Scene, Executor);
+
+		constexpr int32 MaxTicks = 1000;
+		int32 NumTicks = 0;
+		for (; NumTicks < MaxTicks && !ProcessPool.IsFinished(); ++NumTicks)
+		{
+			ProcessPool.Tick(1.0f / 60.0f, Executor);
+		}
+
+		if (!ProcessPool.IsFinished())
+		{
+			UE_LOGFMT(TCSSimulation, Error, "{0}: still running after {1} ticks with commands finished as they start", Scene.GetName(), NumTicks);
+			return false;
+		}
+		return true;
+	}
+
+	FString JoinIndices(TConstArrayView<int32> Indices)
+	{
+		return FString::JoinBy(Indices, TEXT(", "), [](const int32 Index) { return FString::FromInt(Index); });
+	}
+
+	// Plays Scene and compares the commands it started with Expected
+	bool CheckStartedCommands(const UToastieCutsceneAsset& Scene, TConstArrayView<int32> Expected)
+	{
+		FCutsceneSimulationSettings Settings;
+		Settings.bRecordCommands = true;
+		FCutsceneSimulator Simulator(Settings);
+		const auto Result = Simulator.Run(Scene);
+		if (!Result.bFinished)
+		{
+			UE_LOGFMT(TCSSimulation, Error, "{0}: didn't finish", Scene.GetName());
+			return false;
+		}
+		if (Result.StartedCommands != TArray<int32>(Expected))
+		{
+			UE_LOGFMT(TCSSimulation, Error, "{0}: started {1}, expected {2}", Scene.GetName(), JoinIndices(Result.StartedCommands), JoinIndices(Expected));
+			return false;
+		}
+		return true;
+	}
+}
+
+UToastieCutscenesSimulationCommandlet::UToastieCutscenesSimulationCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UToastieCutscenesSimulationCommandlet::Main(const FString& Params)
+{
+	if (FParse::Param(*Params, TEXT("Benchmark")))
+	{
+		int32 NumIterations = 100;
+		int32 Size = 64;
+		FParse::Value(*Params, TEXT("Iterations="), NumIterations);
+		FParse::Value(*Params, TEXT("Size="), Size);
+		return RunBenchmarks(FMath::Max(NumIterations, 1), FMath::Max(Size, 1));
+	}
+
+	if (FParse::Param(*Params, TEXT("TickBenchmark")))
+	{
+		int32 NumScenes = 1000;
+		int32 NumFrames = 600;
+		FParse::Value(*Params, TEXT("Scenes="), NumScenes);
+		FParse::Value(*Params, TEXT("Frames="), NumFrames);
+		return RunTickBenchmark(FMath::Max(NumScenes, 1), FMath::Max(NumFrames, 1));
+	}
+
+	if (FParse::Param(*Params, TEXT("LoadBenchmark")))
+	{
+		int32 NumIterations = 20;
+		int32 NumCommands = 10000;
+		FParse::Value(*Params, TEXT("Iterations="), NumIterations);
+		FParse::Value(*Params, TEXT("Commands="), NumCommands);
+		return RunLoadBenchmark(FMath::Max(NumIterations, 1), FMath::Max(NumCommands, 1));
+	}
+
+	if (FParse::Param(*Params, TEXT("Verify")))
+		return RunChecks();
+
+	FString ScenePath;
+	if (!FParse::Value(*Params, TEXT("Scene="), ScenePath))
+	{
+		UE_LOGFMT(TCSSimulation, Error, "Expected -Scene=<Path>, -Benchmark, -TickBenchmark, -LoadBenchmark or -Verify");
+		return 1;
+	}
+
+	int32 Seed = 0;
+	int32 NumRuns = 1;
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	FParse::Value(*Params, TEXT("Runs="), NumRuns);
+	return SimulateScene(ScenePath, Seed, FMath::Max(NumRuns, 1));
+}
+
+int32 UToastieCutscenesSimulationCommandlet::SimulateScene(const FString& ScenePath, const int32 Seed, const int32 NumRuns)
+{
+	const auto Scene = LoadObject<UToastieCutsceneAsset>(nullptr, *ScenePath);
+	if (!Scene)
+	{
+		UE_LOGFMT(TCSSimulation, Error, "Unable to load Scene {0}", ScenePath);
+		return 1;
+	}
+
+	int32 NumUnfinished = 0;
+	for (int32 Run = 0; Run < NumRuns; ++Run)
+	{
+		FCutsceneSimulationSettings Settings;
+		Settings.Seed = Seed + Run;
+		FCutsceneSimulator Simulator(Settings);
+		const auto Result = Simulator.Run(*Scene);
+
+		UE_LOGFMT(TCSSimulation, Display, "{0} seed {1}: {2} after {3}s, {4} commands, {5} choices, {6} ticks",
+			Scene->GetName(), Settings.Seed, Result.bFinished ? TEXT("finished") : TEXT("timed out"),
+			Result.SimulatedTime, Result.NumCommands, Result.NumChoices, Result.NumTicks);
+		NumUnfinished += Result.bFinished ? 0 : 1;
+	}
+	return NumUnfinished == 0 ? 0 : 1;
+}
+
+int32 UToastieCutscenesSimulationCommandlet::RunBenchmarks(const int32 NumIterations, const int32 Size)
+{
+	const UToastieCutsceneAsset* Scenes[] =
+	{
+		CreateSyntheticScene(TEXT("DeepNesting"), [Size](auto& Commands) { BuildDeepScene(Commands, Size); }),
+		CreateSyntheticScene(TEXT("WideConcurrency"), [Size](auto& Commands) { BuildWideScene(Commands, Size); }),
+		CreateSyntheticScene(TEXT("HeavyBranching"), [Size](auto& Commands) { BuildBranchingScene(Commands, Size, 8); })
+	};
+
+	// Short virtual durations keep the measurement on scheduling rather than idle ticks
+	FCutsceneSimulationSettings Settings;
+	Settings.SayDuration = 0.05f;
+	Settings.LookAtDuration = 0.02f;
+	Settings.PlayerChoiceDuration = 0.02f;
+
+	for (const auto Scene : Scenes)
+	{
+		FCutsceneSimulator Simulator(Settings);
+
+		// The first run grows the pool, the measured ones reuse it like a pooled CutscenePlayer would
+		Simulator.Run(*Scene);
+
+		int64 NumCommands = 0;
+		int64 NumTicks = 0;
+		SIZE_T PeakAllocatedSize = 0;
+		int32 NumUnfinished = 0;
+		const auto StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			const auto Result = Simulator.Run(*Scene);
+			NumCommands += Result.NumCommands;
+			NumTicks += Result.NumTicks;
+			PeakAllocatedSize = FMath::Max(PeakAllocatedSize, Result.PeakAllocatedSize);
+			NumUnfinished += Result.bFinished ? 0 : 1;
+		}
+		const auto Seconds = FMath::Max(FPlatformTime::Seconds() - StartTime, UE_SMALL_NUMBER);
+
+		UE_LOGFMT(TCSSimulation, Display, "{0}: {1} commands, {2} iterations in {3}ms, {4} commands/s, {5} ticks/s, {6} bytes peak pool, {7} bytes scene",
+			Scene->GetName(), Scene->Commands.Num(), NumIterations, Seconds * 1000.0,
+			static_cast<int64>(NumCommands / Seconds), static_cast<int64>(NumTicks / Seconds),
+			static_cast<uint64>(PeakAllocatedSize), static_cast<uint64>(GetSceneSize(*Scene)));
+
+		if (NumUnfinished > 0)
+		{
+			UE_LOGFMT(TCSSimulation, Warning, "{0}: {1} iterations didn't finish", Scene->GetName(), NumUnfinished);
+		}
+	}
+	return 0;
+}
+
+int32 UToastieCutscenesSimulationCommandlet::RunTickBenchmark(const int32 NumScenes, const int32 NumFrames)
+{
+	// Barks with different delays, so runs don't all wake on the same frame
+	UToastieCutsceneAsset* Scenes[] =
+	{
+		CreateSyntheticScene(TEXT("Bark0"), [](auto& Commands) { BuildBarkScene(Commands, 0.25); }),
+		CreateSyntheticScene(TEXT("Bark1"), [](auto& Commands) { BuildBarkScene(Commands, 0.4); }),
+		CreateSyntheticScene(TEXT("Bark2"), [](auto& Commands) { BuildBarkScene(Commands, 0.7); }),
+		CreateSyntheticScene(TEXT("Bark3"), [](auto& Commands) { BuildBarkScene(Commands, 1.1); })
+	};
+
+	const auto World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("ToastieCutscenesTickBenchmark"));
+	auto& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+	World->BeginPlay();
+
+	int32 Result = 0;
+	const auto Subsystem = World->GetSubsystem<UToastieCutsceneSubsystem>();
+	for (int32 SceneIndex = 0; SceneIndex < NumScenes && Subsystem; ++SceneIndex)
+	{
+		if (!Subsystem->PlayScene(Scenes[SceneIndex % UE_ARRAY_COUNT(Scenes)], ACutscenePlayer::StaticClass()))
+		{
+			UE_LOGFMT(TCSSimulation, Error, "Unable to play bark {0}", SceneIndex);
+			Result = 1;
+			break;
+		}
+	}
+
+	if (Subsystem && Result == 0)
+	{
+		// The world tick runs the subsystem along with the timers and actors a game frame would have
+		constexpr float DeltaTime = 1.0f / 60.0f;
+		World->Tick(LEVELTICK_All, DeltaTime);
+
+		const auto StartTime = FPlatformTime::Seconds();
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			World->Tick(LEVELTICK_All, DeltaTime);
+		}
+		const auto Seconds = FMath::Max(FPlatformTime::Seconds() - StartTime, UE_SMALL_NUMBER);
+
+		UE_LOGFMT(TCSSimulation, Display, "{0} scenes: {1} frames in {2}ms, {3}ms per frame, {4} scene ticks/s",
+			NumScenes, NumFrames, Seconds * 1000.0, Seconds * 1000.0 / NumFrames,
+			static_cast<int64>(static_cast<double>(NumScenes) * NumFrames / Seconds));
+	}
+	else if (!Subsystem)
+	{
+		UE_LOGFMT(TCSSimulation, Error, "The benchmark world has no cutscene subsystem");
+		Result = 1;
+	}
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	return Result;
+}
+
+int32 UToastieCutscenesSimulationCommandlet::RunLoadBenchmark(const int32 NumIterations, const int32 NumCommands)
+{
+	// Says, LookAts and Waits in Concurrent conversations, the mix of a long dialogue
+	const auto Scene = CreateSyntheticScene(TEXT("LoadBenchmark"), [NumCommands](auto& Commands)
+	{
+		while (Commands.Num() < NumCommands)
+		{
+			BuildWideScene(Commands, 16);
+		}
+	});
+	const auto Target = NewObject<UToastieCutsceneAsset>(GetTransientPackage(), TEXT("LoadBenchmarkTarget"));
+
+	// Both formats go through the same proxy archive, so names and struct paths cost the same in each
+	const auto Save = [](TArray<uint8>& Data, TFunctionRef<void(FArchive&)> Body)
+	{
+		FMemoryWriter Writer(Data);
+		FObjectAndNameAsStringProxyArchive Ar(Writer, false);
+		Body(Ar);
+	};
+
+	// Loads Data into Target once unmeasured, then NumIterations times timed. Returns false if Target doesn't match Scene
+	const auto MeasureLoad = [&](const TCHAR* Name, const TArray<uint8>& Data, TFunctionRef<void(FArchive&)> Body)
+	{
+		double Seconds = 0.0;
+		for (int32 Iteration = 0; Iteration <= NumIterations; ++Iteration)
+		{
+			FMemoryReader Reader(Data);
+			FObjectAndNameAsStringProxyArchive Ar(Reader, true);
+			const auto StartTime = FPlatformTime::Seconds();
+			Body(Ar);
+			Seconds += Iteration > 0 ? FPlatformTime::Seconds() - StartTime : 0.0;
+		}
+
+		bool bMatches = Target->Commands.Num() == Scene->Commands.Num();
+		for (int32 i = 0; i < Target->Commands.Num() && bMatches; ++i)
+		{
+			bMatches = Target->Commands[i].Identical(&Scene->Commands[i], PPF_None);
+		}
+
+		UE_LOGFMT(TCSSimulation, Display, "{0}: {1} commands, {2} bytes, {3}ms per load, {4} commands/s",
+			Name, Scene->Commands.Num(), Data.Num(), Seconds * 1000.0 / NumIterations,
+			static_cast<int64>(static_cast<double>(Scene->Commands.Num()) * NumIterations / FMath::Max(Seconds, UE_SMALL_NUMBER)));
+		if (!bMatches)
+		{
+			UE_LOGFMT(TCSSimulation, Error, "{0}: loaded commands don't match the saved ones", Name);
+		}
+		return bMatches;
+	};
+
+	TArray<uint8> TaggedData;
+	Save(TaggedData, [Scene](FArchive& Ar) { SerializeTaggedCommands(Ar, Scene->Commands); });
+	TArray<uint8> PackedData;
+	Save(PackedData, [Scene](FArchive& Ar) { UToastieCutsceneAsset::SavePackedCommands(Ar, Scene->Commands); });
+
+	const auto bTaggedMatches = MeasureLoad(TEXT("Tagged"), TaggedData, [Target](FArchive& Ar) { SerializeTaggedCommands(Ar, Target->Commands); });
+	const auto bPackedMatches = MeasureLoad(TEXT("Packed"), PackedData, [Target](FArchive& Ar) { Target->LoadPackedCommands(Ar); });
+	return bTaggedMatches && bPackedMatches ? 0 : 1;
+}
+
+int32 UToastieCutscenesSimulationCommandlet::RunChecks()
+{
+	// Installed before anything is played, the allocation check counts through it later
+	auto& CountingMalloc = FCountingMalloc::Install();
+	int32 NumFailed = 0;
+
+	// Completion of commands in nested Blocks
+	const auto NestedSequential = CreateSyntheticScene(TEXT("NestedSequential"), [](auto& Commands) { BuildNestedSequentialScene(Commands); });
+	NumFailed += CheckStartedCommands(*NestedSequential, { 1, 3, 4, 5, 6 }) ? 0 : 1;
+
+	const auto NestedConcurrent = CreateSyntheticScene(TEXT("NestedConcurrent"), [](auto& Commands) { BuildNestedConcurrentScene(Commands); });
+	NumFailed += CheckStartedCommands(*NestedConcurrent, { 2, 5, 6, 3, 7 }) ? 0 : 1;
+
+	const auto DeepNesting = CreateSyntheticScene(TEXT("DeepNestingCheck"), [](auto& Commands) { BuildDeepScene(Commands, 16); });
+	TArray<int32> DeepExpected;
+	for (int32 Level = 0; Level < 16; ++Level)
+	{
+		DeepExpected.Add(Level * 2 + 1);
+	}
+	for (int32 Level = 0; Level < 16; ++Level)
+	{
+		DeepExpected.Add(32 + Level);
+	}
+	NumFailed += CheckStartedCommands(*DeepNesting, DeepExpected) ? 0 : 1;
+
+	// A process held back by a Block starts its commands in the tick the Block finishes. Durations are exact in binary,
+	// so both Scenes finish on the same tick unless the Say starts a tick late
+	{
+		FCutsceneSimulationSettings Settings;
+		Settings.TickInterval = 0.25f;
+		Settings.SayDuration = 1.0f;
+		const auto HeldBack = CreateSyntheticScene(TEXT("HeldBack"), [](auto& Commands) { BuildHeldBackScene(Commands); });
+		const auto Reference = CreateSyntheticScene(TEXT("HeldBackReference"), [&Settings](auto& Commands) { BuildHeldBackReferenceScene(Commands, Settings.SayDuration); });
+		const auto HeldBackResult = FCutsceneSimulator(Settings).Run(*HeldBack);
+		const auto ReferenceResult = FCutsceneSimulator(Settings).Run(*Reference);
+		if (!HeldBackResult.bFinished || HeldBackResult.NumTicks != ReferenceResult.NumTicks)
+		{
+			UE_LOGFMT(TCSSimulation, Error, "{0}: finished after {1} ticks, expected {2}", HeldBack->GetName(), HeldBackResult.NumTicks, ReferenceResult.NumTicks);
+			++NumFailed;
+		}
+	}
+
+	// Commands finished by the executor while starting stay finished, whether they start in Advance's queue
+	// or in the tick a Block holding them back finished
+	{
+		const auto HeldBack = CreateSyntheticScene(TEXT("HeldBackSynchronous"), [](auto& Commands) { BuildHeldBackScene(Commands); });
+		NumFailed += CheckSynchronousFinish(*NestedSequential) ? 0 : 1;
+		NumFailed += CheckSynchronousFinish(*NestedConcurrent) ? 0 : 1;
+		NumFailed += CheckSynchronousFinish(*HeldBack) ? 0 : 1;
+	}
+
+	// A simulator that already played a Scene holds enough memory to play it again, so its second run doesn't allocate at all.
+	// Only this thread is counted, the editor's own threads keep allocating meanwhile
+	{
+		const auto Nested = CreateSyntheticScene(TEXT("LongNested"), [](auto& Commands)
+		{
+			BuildDeepScene(Commands, 32);
+			BuildWideScene(Commands, 32);
+			BuildBranchingScene(Commands, 32, 8);
+		});
+
+		FCutsceneSimulationSettings Settings;
+		Settings.SayDuration = 0.05f;
+		FCutsceneSimulator Simulator(Settings);
+		Simulator.Run(*Nested);
+
+		CountingMalloc.StartCounting(true);
+		const auto Result = Simulator.Run(*Nested);
+		CountingMalloc.StopCounting();
+		if (!Result.bFinished || CountingMalloc.GetNumAllocations() > 0)
+		{
+			UE_LOGFMT(TCSSimulation, Error, "{0}: {1} allocations of {2} bytes over {3} ticks", Nested->GetName(),
+				CountingMalloc.GetNumAllocations(), CountingMalloc.GetAllocatedBytes(), Result.NumTicks);
+			++NumFailed;
+		}
+	}
+
+	UE_LOGFMT(TCSSimulation, Display, "{0} checks failed", NumFailed);
+	return NumFailed == 0 ? 0 : 1;
+}
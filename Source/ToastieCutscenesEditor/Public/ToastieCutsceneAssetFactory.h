@@ -7,6 +7,8 @@
 
 DECLARE_LOG_CATEGORY_EXTERN(TCSImporter, Log, All);
 
+struct FToastieCutsceneReimportSource;
+
 /**
  * 
  */
@@ -30,5 +32,8 @@ protected:
 	//~ End FReimportHandler
 
 private:
-	TArray<FString> SceneFilter;
+	TSharedPtr<FToastieCutsceneReimportSource> GetReimportSource(const FString& Filename);
+
+	// The last file lexed for a reimport, shared by every Scene reimported from it this frame
+	TSharedPtr<FToastieCutsceneReimportSource> ReimportSource;
 };
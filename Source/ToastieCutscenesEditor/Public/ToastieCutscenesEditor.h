@@ -5,13 +5,24 @@
 #include "AssetTypeCategories.h"
 #include "IAssetTools.h"
 
-class FToastieCutscenesEditorModule : public IModuleInterface
+class TOASTIECUTSCENESEDITOR_API FToastieCutscenesEditorModule : public IModuleInterface
 {
 public:
 	virtual void StartupModule() override;
 	virtual void ShutdownModule() override;
 
+	static FToastieCutscenesEditorModule& Get();
+
+	/**
+	 * Makes a command struct available to the TCS importer under the keyword in its TCS meta.
+	 * The struct must derive from FToastieCutsceneCommandBase, e.g.
+	 * USTRUCT(BlueprintType, meta = (TCS = "PlaySound")) struct FMyPlaySound : public FToastieCutsceneCommandBase
+	 */
+	bool RegisterCommandType(const UScriptStruct* CommandType);
+	void UnregisterCommandType(const UScriptStruct* CommandType);
+
 private:
 
 	TSharedPtr<IAssetTypeActions> ToastieCutsceneAssetTypeActions;
+	FDelegateHandle ReloadCompleteHandle;
 };
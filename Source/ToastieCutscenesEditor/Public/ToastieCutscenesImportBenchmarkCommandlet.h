@@ -0,0 +1,30 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ToastieCutscenesImportBenchmarkCommandlet.generated.h"
+
+/**
+ * Measures each phase of a TCS import and writes the results as JSON, so import time can be tracked between versions.
+ * Lexing, scene splitting and parsing run without creating anything, the import phase also fills the string table
+ * and creates the Scene assets in a transient package. Scenes are parsed both one after another and in parallel,
+ * each file is checked to parse the same both ways first. The stringTable section reports the text memory of the corpus
+ * before and after its lines are shared through the string table.
+ * Allocations are counted in separate runs after the timed ones, so the counting doesn't skew the timings.
+ *
+ * Import every .tcs file under a directory:
+ *	UnrealEditor-Cmd <Project> -run=ToastieCutscenesImportBenchmark -nullrhi -Dir=<Path> [-Iterations=10] [-AllocIterations=1] [-Output=<File.json>]
+ *
+ * Import a generated corpus, by default a single file of 500 Scenes:
+ *	UnrealEditor-Cmd <Project> -run=ToastieCutscenesImportBenchmark -nullrhi [-Files=1] [-Scenes=500] [-Lines=200]
+ */
+UCLASS()
+class TOASTIECUTSCENESEDITOR_API UToastieCutscenesImportBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UToastieCutscenesImportBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
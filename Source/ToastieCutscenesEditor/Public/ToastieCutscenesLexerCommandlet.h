@@ -0,0 +1,25 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ToastieCutscenesLexerCommandlet.generated.h"
+
+/**
+ * Checks the TCS scanner against the regex lexer it replaced. Both lex every input, and their results must agree on
+ * success, and on every sentence and token down to its type, text, line and column.
+ * The built-in corpus covers the edge cases of each pattern: quotes, numbers like "1." and ".5", comments,
+ * and CRLF, CR and Unicode line ends.
+ *
+ * Check the built-in corpus, and every .tcs file under a directory if one is given:
+ *	UnrealEditor-Cmd <Project> -run=ToastieCutscenesLexer -nullrhi [-Dir=<Path>]
+ */
+UCLASS()
+class TOASTIECUTSCENESEDITOR_API UToastieCutscenesLexerCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UToastieCutscenesLexerCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
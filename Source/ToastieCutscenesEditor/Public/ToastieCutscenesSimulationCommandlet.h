@@ -0,0 +1,41 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ToastieCutscenesSimulationCommandlet.generated.h"
+
+/**
+ * Plays Scenes headlessly with FCutsceneSimulator, no world or Blueprint needed.
+ *
+ * Simulate an imported Scene, once per seed:
+ *	UnrealEditor-Cmd <Project> -run=ToastieCutscenesSimulation -Scene=/Game/Cutscenes/Intro [-Seed=0] [-Runs=1]
+ *
+ * Measure scheduling throughput on synthetic Scenes with deep nesting, wide concurrency and heavy branching:
+ *	UnrealEditor-Cmd <Project> -run=ToastieCutscenesSimulation -Benchmark [-Iterations=100] [-Size=64]
+ *
+ * Measure the world subsystem ticking many looping bark Scenes at once, each on its own pooled CutscenePlayer:
+ *	UnrealEditor-Cmd <Project> -run=ToastieCutscenesSimulation -TickBenchmark [-Scenes=1000] [-Frames=600]
+ *
+ * Measure loading a Scene's commands from tagged properties, as editor data stores them, and from the packed cooked blob:
+ *	UnrealEditor-Cmd <Project> -run=ToastieCutscenesSimulation -LoadBenchmark [-Iterations=20] [-Commands=10000]
+ *
+ * Check the scheduling of nested Sequential and Concurrent Blocks, and that a warmed up pool ticks without allocating:
+ *	UnrealEditor-Cmd <Project> -run=ToastieCutscenesSimulation -Verify
+ */
+UCLASS()
+class TOASTIECUTSCENESEDITOR_API UToastieCutscenesSimulationCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UToastieCutscenesSimulationCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	int32 SimulateScene(const FString& ScenePath, const int32 Seed, const int32 NumRuns);
+	int32 RunBenchmarks(const int32 NumIterations, const int32 Size);
+	int32 RunTickBenchmark(const int32 NumScenes, const int32 NumFrames);
+	int32 RunLoadBenchmark(const int32 NumIterations, const int32 NumCommands);
+	int32 RunChecks();
+};
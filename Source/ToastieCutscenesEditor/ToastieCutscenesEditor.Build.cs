@@ -38,6 +38,7 @@ public class ToastieCutscenesEditor : ModuleRules
 				"SlateCore",
 				"UnrealEd",
 				"AssetTools",
+				"Json",
 				"ToastieCutscenes"
 				// ... add private dependencies that you statically link with here ...	
 			}